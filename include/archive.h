@@ -3,31 +3,67 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <string>
 #include <type_traits>
 #include <vector>
 
 
-#define SIREN_SERDES(...)                                      \
-    void serialize(::siren::Archive *archive) const {          \
-        (::siren::detail::Serializer(archive)), __VA_ARGS__;   \
-    }                                                          \
-                                                               \
-    void deserialize(::siren::Archive *archive) {              \
-        (::siren::detail::Deserializer(archive)), __VA_ARGS__; \
+#define SIREN_SERDES(...)                                                                   \
+    void serialize(::siren::Archive *archive) const {                                       \
+        (::siren::detail::Serializer(archive)), __VA_ARGS__, ::siren::detail::FieldListEnd(); \
+    }                                                                                       \
+                                                                                            \
+    void deserialize(::siren::Archive *archive) {                                           \
+        (::siren::detail::Deserializer(archive)), __VA_ARGS__                               \
+                                                , ::siren::detail::FieldListEnd();          \
     }
 
 #define SIREN__LIKE_CHAR(T) \
     ((sizeof(T) == sizeof(char) && alignof(T) == alignof(char)) && std::is_pod<T>::value)
 
+#define SIREN__FIXED_WIDTH(T)                                     \
+    ((std::is_integral<T>::value || std::is_same<T, float>::value \
+      || std::is_same<T, double>::value) && !SIREN__LIKE_CHAR(T))
+
 
 namespace siren {
 
 class Stream;
+class StringView;
+
+namespace detail {
+
+enum class ArchiveMode
+{
+    Normal = 0,
+    Sizing,
+    Unchecked,
+};
+
+
+enum class ArchiveWireType
+{
+    VLI = 0,
+    Fixed1,
+    Fixed2,
+    Fixed4,
+    Fixed8,
+    Block,
+};
+
+
+class Serializer;
+class Deserializer;
+
+} // namespace detail
 
 template <class T, bool = std::is_integral<T>::value>
 class VLI;
 
+template <class T>
+class ArrayView;
+
 
 class Archive final
 {
@@ -40,6 +76,8 @@ public:
     inline Archive &operator>>(double &);
     inline Archive &operator<<(const std::string &);
     inline Archive &operator>>(std::string &);
+    inline Archive &operator<<(StringView);
+    inline Archive &operator>>(StringView &);
 
     template <class T>
     inline std::enable_if_t<std::is_integral<T>::value, Archive &> operator<<(T);
@@ -83,15 +121,30 @@ public:
     template <class T>
     inline std::enable_if_t<!SIREN__LIKE_CHAR(T), Archive &> operator>>(std::vector<T> &);
 
+    template <class T>
+    inline Archive &operator<<(ArrayView<T>);
+
+    template <class T>
+    inline Archive &operator>>(ArrayView<T> &);
+
     template <class T>
     inline std::enable_if_t<std::is_class<T>::value, Archive &> operator<<(const T &);
 
     template <class T>
     inline std::enable_if_t<std::is_class<T>::value, Archive &> operator>>(T &);
 
+    template <class T>
+    inline std::size_t measure(const T &);
+
+    template <class T>
+    inline Archive &serializeAtOnce(const T &);
+
     inline bool isValid() const noexcept;
+    inline bool isTagged() const noexcept;
+    inline void setTagged(bool) noexcept;
     inline std::size_t getNumberOfPreReadBytes() const noexcept;
     inline std::size_t getNumberOfPreWrittenBytes() const noexcept;
+    inline void setMaxNumberOfPreReadBytes(std::size_t) noexcept;
 
     explicit Archive(Stream *, std::size_t = 0, std::size_t = 0) noexcept;
     Archive(Archive &&) noexcept;
@@ -99,11 +152,43 @@ public:
 
     void serializeBytes(const void *, std::size_t);
     void deserializeBytes(void *, std::size_t);
+    void beginChecksum() noexcept;
+    void serializeChecksum();
+    void deserializeChecksum();
+    const void *viewBytes(std::size_t);
+
+    template <class T>
+    inline std::enable_if_t<std::is_integral<T>::value
+                            , void> serializeVariableLengthIntegers(const T *, std::size_t);
+
+    template <class T>
+    inline std::enable_if_t<std::is_integral<T>::value
+                            , void> deserializeVariableLengthIntegers(T *, std::size_t);
 
 private:
+    static constexpr std::size_t MaxVariableLengthIntegerSize
+        = (std::numeric_limits<std::uintmax_t>::digits + 6) / 7;
+
+    typedef detail::ArchiveMode Mode;
+    typedef detail::ArchiveWireType WireType;
+
     Stream *stream_;
+    Mode mode_;
+    bool isTagged_;
     std::size_t preReadByteCount_;
+    std::size_t maxPreReadByteCount_;
     std::size_t preWrittenByteCount_;
+    bool checksumIsEnabled_;
+    std::uint32_t readChecksum_;
+    std::uint32_t writeChecksum_;
+    std::size_t checksumWriteOffset_;
+
+    static std::uint32_t UpdateChecksum(std::uint32_t, const void *, std::size_t) noexcept;
+
+    inline std::size_t getDataSize() const noexcept;
+    inline bool reserveBuffer(std::size_t);
+    inline void updateWriteChecksum(std::size_t) noexcept;
+    inline void updateReadChecksum(std::size_t) noexcept;
 
     template <class T>
     inline std::enable_if_t<std::is_integral<T>::value && std::is_unsigned<T>::value
@@ -113,10 +198,45 @@ private:
     inline std::enable_if_t<std::is_integral<T>::value && std::is_unsigned<T>::value
                             , void> deserializeInteger(T *);
 
+    template <class T>
+    inline std::enable_if_t<SIREN__FIXED_WIDTH(T), void> serializeElements(const T *
+                                                                            , std::size_t);
+
+    template <class T>
+    inline std::enable_if_t<!SIREN__FIXED_WIDTH(T), void> serializeElements(const T *
+                                                                             , std::size_t);
+
+    template <class T>
+    inline void serializeElements(const VLI<T> *, std::size_t);
+
+    template <class T>
+    inline std::enable_if_t<SIREN__FIXED_WIDTH(T), void> deserializeElements(T *, std::size_t);
+
+    template <class T>
+    inline void deserializeElements(VLI<T> *, std::size_t);
+
+    template <class T>
+    inline std::enable_if_t<!SIREN__FIXED_WIDTH(T), void> deserializeElements(T *, std::size_t);
+
     void initialize(Stream *, std::size_t, std::size_t) noexcept;
     void move(Archive *) noexcept;
+    static std::size_t EncodeVariableLengthInteger(std::uintmax_t, unsigned char *) noexcept;
+    static std::size_t DecodeVariableLengthInteger(const unsigned char *, std::size_t
+                                                   , std::uintmax_t *) noexcept;
+
     void serializeVariableLengthInteger(std::uintmax_t);
     void deserializeVariableLengthInteger(std::uintmax_t *);
+    const void *viewElements(std::uintmax_t, std::size_t);
+    void serializeFieldKey(unsigned int, WireType);
+    unsigned int peekFieldKey(WireType *, std::size_t *);
+    std::size_t beginBlock();
+    void endBlock(std::size_t) noexcept;
+    std::size_t deserializeBlock();
+    void skipBlock(std::size_t);
+    void skipField(WireType);
+
+    friend detail::Serializer;
+    friend detail::Deserializer;
 };
 
 
@@ -136,6 +256,84 @@ private:
 
 namespace detail {
 
+class StreamView
+{
+protected:
+    const char *data_;
+    std::size_t length_;
+#ifdef SIREN_WITH_DEBUG
+    const Stream *stream_;
+    std::size_t streamGeneration_;
+#endif
+
+    inline explicit StreamView() noexcept;
+
+    inline void check() const noexcept;
+    inline void reset(const Stream *, const void *, std::size_t) noexcept;
+};
+
+} // namespace detail
+
+
+class StringView final
+  : private detail::StreamView
+{
+public:
+    inline explicit StringView() noexcept;
+
+    inline const char *getData() const noexcept;
+    inline std::size_t getLength() const noexcept;
+    inline std::string toString() const;
+
+private:
+    friend Archive;
+};
+
+
+template <class T>
+class ArrayView final
+  : private detail::StreamView
+{
+    static_assert(std::is_arithmetic<T>::value || SIREN__LIKE_CHAR(T), "");
+
+public:
+    inline explicit ArrayView() noexcept;
+    inline T operator[](std::size_t) const noexcept;
+
+    inline const void *getData() const noexcept;
+    inline std::size_t getLength() const noexcept;
+    inline std::vector<T> toVector() const;
+
+private:
+    friend Archive;
+};
+
+
+namespace detail {
+
+struct FieldListEnd
+{
+};
+
+
+template <class T>
+struct ArchiveWireTypeOf
+{
+    static constexpr ArchiveWireType Value
+        = !std::is_arithmetic<T>::value && !std::is_enum<T>::value ? ArchiveWireType::Block
+          : sizeof(T) == 1 ? ArchiveWireType::Fixed1
+          : sizeof(T) == 2 ? ArchiveWireType::Fixed2
+          : sizeof(T) == 4 ? ArchiveWireType::Fixed4 : ArchiveWireType::Fixed8;
+};
+
+
+template <class T>
+struct ArchiveWireTypeOf<VLI<T>>
+{
+    static constexpr ArchiveWireType Value = ArchiveWireType::VLI;
+};
+
+
 class Serializer final
 {
 public:
@@ -144,8 +342,11 @@ public:
     template <class T>
     inline const Serializer &operator,(const T &) const;
 
+    inline void operator,(FieldListEnd) const;
+
 private:
     Archive *const archive_;
+    mutable unsigned int fieldNumber_;
 
     Serializer(const Serializer &) = delete;
     Serializer &operator=(const Serializer &) = delete;
@@ -160,8 +361,11 @@ public:
     template <class T>
     inline const Deserializer &operator,(T &) const;
 
+    inline void operator,(FieldListEnd) const;
+
 private:
     Archive *const archive_;
+    mutable unsigned int fieldNumber_;
 
     Deserializer(const Deserializer &) = delete;
     Deserializer &operator=(const Deserializer &) = delete;
@@ -177,9 +381,11 @@ private:
  */
 
 
-#include <limits>
+#include <algorithm>
+#include <cstring>
 
 #include "assert.h"
+#include "scope_guard.h"
 #include "stream.h"
 #include "utility.h"
 
@@ -271,6 +477,27 @@ Archive::operator>>(std::string &string)
 }
 
 
+Archive &
+Archive::operator<<(StringView stringView)
+{
+    SIREN_ASSERT(isValid());
+    serializeVariableLengthInteger(stringView.getLength());
+    serializeBytes(stringView.getData(), stringView.getLength());
+    return *this;
+}
+
+
+Archive &
+Archive::operator>>(StringView &stringView)
+{
+    SIREN_ASSERT(isValid());
+    std::uintmax_t temp;
+    deserializeVariableLengthInteger(&temp);
+    stringView.reset(stream_, viewBytes(temp), temp);
+    return *this;
+}
+
+
 template <class T>
 std::enable_if_t<std::is_integral<T>::value, Archive &>
 Archive::operator<<(T integer)
@@ -392,11 +619,7 @@ std::enable_if_t<!SIREN__LIKE_CHAR(T), Archive &>
 Archive::operator<<(const T (&array)[N])
 {
     SIREN_ASSERT(isValid());
-
-    for (const T &x : array) {
-        operator<<(x);
-    }
-
+    serializeElements(array, N);
     return *this;
 }
 
@@ -406,11 +629,7 @@ std::enable_if_t<!SIREN__LIKE_CHAR(T), Archive &>
 Archive::operator>>(T (&array)[N])
 {
     SIREN_ASSERT(isValid());
-
-    for (T &x : array) {
-        operator>>(x);
-    }
-
+    deserializeElements(array, N);
     return *this;
 }
 
@@ -421,11 +640,7 @@ Archive::operator<<(const std::vector<T> &vector)
 {
     SIREN_ASSERT(isValid());
     serializeVariableLengthInteger(vector.size());
-
-    for (const T &x : vector) {
-        operator<<(x);
-    }
-
+    serializeElements(vector.data(), vector.size());
     return *this;
 }
 
@@ -437,11 +652,30 @@ Archive::operator>>(std::vector<T> &vector)
     SIREN_ASSERT(isValid());
     std::uintmax_t temp;
     vector.resize((deserializeVariableLengthInteger(&temp), temp));
+    deserializeElements(vector.data(), vector.size());
+    return *this;
+}
 
-    for (T &x : vector) {
-        operator>>(x);
-    }
 
+template <class T>
+Archive &
+Archive::operator<<(ArrayView<T> arrayView)
+{
+    SIREN_ASSERT(isValid());
+    serializeVariableLengthInteger(arrayView.getLength());
+    serializeBytes(arrayView.getData(), arrayView.getLength() * sizeof(T));
+    return *this;
+}
+
+
+template <class T>
+Archive &
+Archive::operator>>(ArrayView<T> &arrayView)
+{
+    SIREN_ASSERT(isValid());
+    std::uintmax_t temp;
+    deserializeVariableLengthInteger(&temp);
+    arrayView.reset(stream_, viewElements(temp, sizeof(T)), temp);
     return *this;
 }
 
@@ -466,12 +700,64 @@ Archive::operator>>(T &object)
 }
 
 
+template <class T>
+std::size_t
+Archive::measure(const T &object)
+{
+    SIREN_ASSERT(isValid());
+    Mode mode = mode_;
+    std::size_t numberOfPreWrittenBytes = preWrittenByteCount_;
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        mode_ = mode;
+        preWrittenByteCount_ = numberOfPreWrittenBytes;
+    });
+
+    // run the same serialize member, counting bytes instead of writing them
+    mode_ = Mode::Sizing;
+    operator<<(object);
+    return preWrittenByteCount_ - numberOfPreWrittenBytes;
+}
+
+
+template <class T>
+Archive &
+Archive::serializeAtOnce(const T &object)
+{
+    SIREN_ASSERT(isValid());
+
+    if (mode_ != Mode::Normal) {
+        return operator<<(object);
+    }
+
+    stream_->reserveBuffer(preWrittenByteCount_ + measure(object));
+    auto scopeGuard = MakeScopeGuard([&] () -> void { mode_ = Mode::Normal; });
+    mode_ = Mode::Unchecked;
+    return operator<<(object);
+}
+
+
 bool
 Archive::isValid() const noexcept
 {
     return stream_ != nullptr;
 }
 
+
+bool
+Archive::isTagged() const noexcept
+{
+    return isTagged_;
+}
+
+
+void
+Archive::setTagged(bool isTagged) noexcept
+{
+    isTagged_ = isTagged;
+}
+
+
 std::size_t
 Archive::getNumberOfPreReadBytes() const noexcept
 {
@@ -486,6 +772,60 @@ Archive::getNumberOfPreWrittenBytes() const noexcept
 }
 
 
+void
+Archive::setMaxNumberOfPreReadBytes(std::size_t maxNumberOfPreReadBytes) noexcept
+{
+    maxPreReadByteCount_ = maxNumberOfPreReadBytes;
+}
+
+
+std::size_t
+Archive::getDataSize() const noexcept
+{
+    return std::min(stream_->getDataSize(), maxPreReadByteCount_);
+}
+
+
+bool
+Archive::reserveBuffer(std::size_t numberOfBytes)
+{
+    switch (mode_) {
+    case Mode::Normal:
+        stream_->reserveBuffer(preWrittenByteCount_ + numberOfBytes);
+        return true;
+
+    case Mode::Sizing:
+        preWrittenByteCount_ += numberOfBytes;
+        return false;
+
+    default:
+        SIREN_ASSERT(stream_->getBufferSize() >= preWrittenByteCount_ + numberOfBytes);
+        return true;
+    }
+}
+
+
+void
+Archive::updateWriteChecksum(std::size_t numberOfBytes) noexcept
+{
+    // fold the bytes in right after they are stored, so no second pass over them is needed
+    if (checksumIsEnabled_) {
+        writeChecksum_ = UpdateChecksum(writeChecksum_, stream_->getBuffer(preWrittenByteCount_)
+                                        , numberOfBytes);
+    }
+}
+
+
+void
+Archive::updateReadChecksum(std::size_t numberOfBytes) noexcept
+{
+    if (checksumIsEnabled_) {
+        readChecksum_ = UpdateChecksum(readChecksum_, stream_->getData(preReadByteCount_)
+                                       , numberOfBytes);
+    }
+}
+
+
 template <class T>
 std::enable_if_t<std::is_integral<T>::value && std::is_unsigned<T>::value, void>
 Archive::serializeInteger(T integer)
@@ -493,7 +833,10 @@ Archive::serializeInteger(T integer)
     constexpr unsigned int k1 = std::numeric_limits<T>::digits;
     constexpr unsigned int k2 = std::numeric_limits<unsigned char>::digits;
 
-    stream_->reserveBuffer(preWrittenByteCount_ + sizeof(T));
+    if (!reserveBuffer(sizeof(T))) {
+        return;
+    }
+
     auto buffer = static_cast<unsigned char *>(stream_->getBuffer(preWrittenByteCount_));
     *buffer = integer;
 
@@ -501,6 +844,7 @@ Archive::serializeInteger(T integer)
         *++buffer = (integer >>= k2);
     }
 
+    updateWriteChecksum(sizeof(T));
     preWrittenByteCount_ += sizeof(T);
 }
 
@@ -512,7 +856,7 @@ Archive::deserializeInteger(T *integer)
     constexpr unsigned int k1 = std::numeric_limits<T>::digits;
     constexpr unsigned int k2 = std::numeric_limits<unsigned char>::digits;
 
-    if (stream_->getDataSize() < preReadByteCount_ + sizeof(T)) {
+    if (getDataSize() < preReadByteCount_ + sizeof(T)) {
         throw EndOfStream();
     }
 
@@ -523,10 +867,161 @@ Archive::deserializeInteger(T *integer)
         *integer |= static_cast<T>(*++data) << n;
     }
 
+    updateReadChecksum(sizeof(T));
     preReadByteCount_ += sizeof(T);
 }
 
 
+template <class T>
+std::enable_if_t<SIREN__FIXED_WIDTH(T), void>
+Archive::serializeElements(const T *elements, std::size_t numberOfElements)
+{
+    std::size_t numberOfBytes = numberOfElements * sizeof(T);
+
+    if (!reserveBuffer(numberOfBytes)) {
+        return;
+    }
+
+    auto buffer = static_cast<char *>(stream_->getBuffer(preWrittenByteCount_));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // the wire format is little-endian already, so one copy does it all
+    std::memcpy(buffer, elements, numberOfBytes);
+#else
+    for (std::size_t i = 0; i < numberOfBytes; i += sizeof(T)) {
+        std::reverse_copy(reinterpret_cast<const char *>(elements) + i
+                          , reinterpret_cast<const char *>(elements) + i + sizeof(T), buffer + i);
+    }
+#endif
+    updateWriteChecksum(numberOfBytes);
+    preWrittenByteCount_ += numberOfBytes;
+}
+
+
+template <class T>
+std::enable_if_t<!SIREN__FIXED_WIDTH(T), void>
+Archive::serializeElements(const T *elements, std::size_t numberOfElements)
+{
+    for (std::size_t i = 0; i < numberOfElements; ++i) {
+        operator<<(elements[i]);
+    }
+}
+
+
+template <class T>
+std::enable_if_t<SIREN__FIXED_WIDTH(T), void>
+Archive::deserializeElements(T *elements, std::size_t numberOfElements)
+{
+    std::size_t numberOfBytes = numberOfElements * sizeof(T);
+
+    if (numberOfBytes > getDataSize() - preReadByteCount_) {
+        throw EndOfStream();
+    }
+
+    auto data = static_cast<const char *>(stream_->getData(preReadByteCount_));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(elements, data, numberOfBytes);
+#else
+    for (std::size_t i = 0; i < numberOfBytes; i += sizeof(T)) {
+        std::reverse_copy(data + i, data + i + sizeof(T), reinterpret_cast<char *>(elements) + i);
+    }
+#endif
+    updateReadChecksum(numberOfBytes);
+    preReadByteCount_ += numberOfBytes;
+}
+
+
+template <class T>
+std::enable_if_t<!SIREN__FIXED_WIDTH(T), void>
+Archive::deserializeElements(T *elements, std::size_t numberOfElements)
+{
+    for (std::size_t i = 0; i < numberOfElements; ++i) {
+        operator>>(elements[i]);
+    }
+}
+
+
+template <class T>
+void
+Archive::serializeElements(const VLI<T> *elements, std::size_t numberOfElements)
+{
+    serializeVariableLengthIntegers(reinterpret_cast<const T *>(elements), numberOfElements);
+}
+
+
+template <class T>
+void
+Archive::deserializeElements(VLI<T> *elements, std::size_t numberOfElements)
+{
+    deserializeVariableLengthIntegers(reinterpret_cast<T *>(elements), numberOfElements);
+}
+
+
+template <class T>
+std::enable_if_t<std::is_integral<T>::value, void>
+Archive::serializeVariableLengthIntegers(const T *integers, std::size_t numberOfIntegers)
+{
+    SIREN_ASSERT(isValid());
+
+    if (mode_ == Mode::Sizing) {
+        unsigned char buffer[MaxVariableLengthIntegerSize];
+
+        for (std::size_t i = 0; i < numberOfIntegers; ++i) {
+            preWrittenByteCount_ += EncodeVariableLengthInteger(integers[i], buffer);
+        }
+
+        return;
+    }
+
+    if (mode_ == Mode::Normal) {
+        // reserve for the worst case once, then encode without any checks
+        stream_->reserveBuffer(preWrittenByteCount_
+                               + numberOfIntegers * MaxVariableLengthIntegerSize);
+    }
+
+    auto buffer = static_cast<unsigned char *>(stream_->getBuffer(preWrittenByteCount_));
+    std::size_t bufferSize = 0;
+
+    for (std::size_t i = 0; i < numberOfIntegers; ++i) {
+        bufferSize += EncodeVariableLengthInteger(integers[i], buffer + bufferSize);
+    }
+
+    updateWriteChecksum(bufferSize);
+    preWrittenByteCount_ += bufferSize;
+}
+
+
+template <class T>
+std::enable_if_t<std::is_integral<T>::value, void>
+Archive::deserializeVariableLengthIntegers(T *integers, std::size_t numberOfIntegers)
+{
+    SIREN_ASSERT(isValid());
+
+    if (getDataSize() < preReadByteCount_) {
+        throw EndOfStream();
+    }
+
+    auto data = static_cast<const unsigned char *>(stream_->getData(preReadByteCount_));
+    std::size_t dataSize = getDataSize() - preReadByteCount_;
+    std::size_t dataOffset = 0;
+
+    for (std::size_t i = 0; i < numberOfIntegers; ++i) {
+        std::uintmax_t temp;
+        std::size_t n = DecodeVariableLengthInteger(data + dataOffset, dataSize - dataOffset
+                                                    , &temp);
+
+        if (n == 0) {
+            throw EndOfStream();
+        }
+
+        dataOffset += n;
+        integers[i] = UnsignedToSigned(temp);
+    }
+
+    updateReadChecksum(dataOffset);
+    preReadByteCount_ += dataOffset;
+}
+
+
 template <class T>
 VLI<T, true>::VLI()
 {
@@ -554,10 +1049,131 @@ VLI<T, true>::operator T &()
 }
 
 
+namespace detail {
+
+StreamView::StreamView() noexcept
+  : data_(nullptr),
+    length_(0)
+{
+#ifdef SIREN_WITH_DEBUG
+    stream_ = nullptr;
+#endif
+}
+
+
+void
+StreamView::check() const noexcept
+{
+#ifdef SIREN_WITH_DEBUG
+    // catch views used after the stream discarded or moved their bytes
+    SIREN_ASSERT(stream_ == nullptr || stream_->getGeneration() == streamGeneration_);
+#endif
+}
+
+
+void
+StreamView::reset(const Stream *stream, const void *data, std::size_t length) noexcept
+{
+    data_ = static_cast<const char *>(data);
+    length_ = length;
+#ifdef SIREN_WITH_DEBUG
+    stream_ = stream;
+    streamGeneration_ = stream->getGeneration();
+#else
+    SIREN_UNUSED(stream);
+#endif
+}
+
+} // namespace detail
+
+
+StringView::StringView() noexcept
+{
+}
+
+
+const char *
+StringView::getData() const noexcept
+{
+    check();
+    return data_;
+}
+
+
+std::size_t
+StringView::getLength() const noexcept
+{
+    return length_;
+}
+
+
+std::string
+StringView::toString() const
+{
+    return std::string(getData(), length_);
+}
+
+
+template <class T>
+ArrayView<T>::ArrayView() noexcept
+{
+}
+
+
+template <class T>
+T
+ArrayView<T>::operator[](std::size_t index) const noexcept
+{
+    SIREN_ASSERT(index < length_);
+    check();
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, data_ + index * sizeof(T), sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // elements are stored little-endian
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+    T element;
+    std::memcpy(&element, bytes, sizeof(T));
+    return element;
+}
+
+
+template <class T>
+const void *
+ArrayView<T>::getData() const noexcept
+{
+    check();
+    return data_;
+}
+
+
+template <class T>
+std::size_t
+ArrayView<T>::getLength() const noexcept
+{
+    return length_;
+}
+
+
+template <class T>
+std::vector<T>
+ArrayView<T>::toVector() const
+{
+    std::vector<T> vector(length_);
+
+    for (std::size_t i = 0; i < length_; ++i) {
+        vector[i] = operator[](i);
+    }
+
+    return vector;
+}
+
+
 namespace detail {
 
 Serializer::Serializer(Archive *archive) noexcept
-  : archive_(archive)
+  : archive_(archive),
+    fieldNumber_(0)
 {
 }
 
@@ -566,13 +1182,40 @@ template <class T>
 const Serializer &
 Serializer::operator,(const T &x) const
 {
-    *archive_ << x;
+    constexpr ArchiveWireType wireType = ArchiveWireTypeOf<T>::Value;
+
+    if (!archive_->isTagged()) {
+        *archive_ << x;
+        return *this;
+    }
+
+    archive_->serializeFieldKey(++fieldNumber_, wireType);
+
+    if (wireType == ArchiveWireType::Block) {
+        // length-prefixed, so that readers which do not know the field can skip it
+        std::size_t blockOffset = archive_->beginBlock();
+        *archive_ << x;
+        archive_->endBlock(blockOffset);
+    } else {
+        *archive_ << x;
+    }
+
     return *this;
 }
 
 
+void
+Serializer::operator,(FieldListEnd) const
+{
+    if (archive_->isTagged()) {
+        archive_->serializeFieldKey(0, ArchiveWireType::VLI);
+    }
+}
+
+
 Deserializer::Deserializer(Archive *archive) noexcept
-  : archive_(archive)
+  : archive_(archive),
+    fieldNumber_(0)
 {
 }
 
@@ -581,8 +1224,67 @@ template <class T>
 const Deserializer &
 Deserializer::operator,(T &x) const
 {
-    *archive_ >> x;
-    return *this;
+    constexpr ArchiveWireType wireType = ArchiveWireTypeOf<T>::Value;
+
+    if (!archive_->isTagged()) {
+        *archive_ >> x;
+        return *this;
+    }
+
+    ++fieldNumber_;
+
+    // fields come in ascending order, so merge them with the declared ones: older fields are
+    // skipped, a newer one means this field is missing and keeps its value
+    for (;;) {
+        ArchiveWireType fieldWireType;
+        std::size_t keySize;
+        unsigned int fieldNumber = archive_->peekFieldKey(&fieldWireType, &keySize);
+
+        if (fieldNumber == 0 || fieldNumber > fieldNumber_) {
+            return *this;
+        }
+
+        archive_->updateReadChecksum(keySize);
+        archive_->preReadByteCount_ += keySize;
+
+        if (fieldNumber < fieldNumber_ || fieldWireType != wireType) {
+            archive_->skipField(fieldWireType);
+            continue;
+        }
+
+        if (wireType == ArchiveWireType::Block) {
+            std::size_t blockEnd = archive_->deserializeBlock();
+            *archive_ >> x;
+            archive_->skipBlock(blockEnd);
+        } else {
+            *archive_ >> x;
+        }
+
+        return *this;
+    }
+}
+
+
+void
+Deserializer::operator,(FieldListEnd) const
+{
+    if (!archive_->isTagged()) {
+        return;
+    }
+
+    for (;;) {
+        ArchiveWireType fieldWireType;
+        std::size_t keySize;
+        unsigned int fieldNumber = archive_->peekFieldKey(&fieldWireType, &keySize);
+        archive_->updateReadChecksum(keySize);
+        archive_->preReadByteCount_ += keySize;
+
+        if (fieldNumber == 0) {
+            return;
+        }
+
+        archive_->skipField(fieldWireType);
+    }
 }
 
 } // namespace detail
@@ -591,3 +1293,4 @@ Deserializer::operator,(T &x) const
 
 
 #undef SIREN__LIKE_CHAR
+#undef SIREN__FIXED_WIDTH
@@ -2,55 +2,205 @@
 
 
 #include <cstddef>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <type_traits>
 
+#include "event.h"
+#include "object_pool.h"
 #include "thread_pool.h"
 
 
 namespace siren {
 
-class Event;
+class Async;
 class Loop;
-namespace detail { struct AsyncTask; }
+template <class T> class AsyncFuture;
+
+
+enum class AsyncLane
+{
+    Default = 0,
+    DNS,
+    Disk,
+    CPU,
+};
+
+
+namespace detail {
+
+constexpr std::size_t NumberOfAsyncLanes = 4;
+
+
+struct AsyncWaiter
+{
+    Event event;
+    std::size_t taskCount;
+};
+
+
+struct AsyncTask
+  : ThreadPoolTask
+{
+    ThreadPool *threadPool;
+    AsyncWaiter *waiter;
+    bool isCompleted;
+    int errorNumber;
+    void (*procedureDestructor)(void *);
+    alignas(std::max_align_t) unsigned char procedure[8 * sizeof(void *)];
+    alignas(std::max_align_t) unsigned char result[4 * sizeof(void *)];
+
+    inline explicit AsyncTask() noexcept;
+};
+
+
+struct AsyncParallelRange
+{
+    std::atomic<std::size_t> nextIndex;
+    std::size_t lastIndex;
+    AsyncTask *task;
+};
+
+
+template <class T, std::size_t N, bool = (sizeof(T) <= N
+                                         && alignof(T) <= alignof(std::max_align_t))>
+struct AsyncStorage;
+
+
+template <class T>
+struct AsyncResult;
+
+} // namespace detail
 
 
 class Async final
 {
 public:
     inline bool isValid() const noexcept;
+    inline const ThreadPool *getThreadPool(AsyncLane = AsyncLane::Default) const noexcept;
+
+    inline static bool CurrentTaskIsCancelled() noexcept;
+
+    template <class T, class ...U>
+    inline std::enable_if_t<std::is_void<std::result_of_t<T(U ...)>>::value
+                            , void> callFunction(T &&, U ...);
+
+    template <class T, class ...U>
+    inline std::enable_if_t<!std::is_void<std::result_of_t<T(U ...)>>::value
+                            && !std::is_reference<std::result_of_t<T(U ...)>>::value
+                            , std::result_of_t<T(U ...)>> callFunction(T &&, U ...);
 
     template <class T, class ...U>
     std::enable_if_t<std::is_void<std::result_of_t<T(U ...)>>::value
-                     , void> callFunction(T &&, U ...);
+                     , void> callFunction(AsyncLane, T &&, U ...);
 
     template <class T, class ...U>
     std::enable_if_t<!std::is_void<std::result_of_t<T(U ...)>>::value
                      && !std::is_reference<std::result_of_t<T(U ...)>>::value
-                     , std::result_of_t<T(U ...)>> callFunction(T &&, U ...);
+                     , std::result_of_t<T(U ...)>> callFunction(AsyncLane, T &&, U ...);
+
+    template <class T, class ...U>
+    inline std::enable_if_t<!std::is_reference<std::result_of_t<std::decay_t<T>(U ...)>>::value
+                            , AsyncFuture<std::result_of_t<std::decay_t<T>(U ...)>>>
+        submit(T &&, U ...);
 
-    explicit Async(Loop *, std::size_t = 0);
+    template <class T, class ...U>
+    std::enable_if_t<!std::is_reference<std::result_of_t<std::decay_t<T>(U ...)>>::value
+                     , AsyncFuture<std::result_of_t<std::decay_t<T>(U ...)>>>
+        submit(AsyncLane, T &&, U ...);
+
+    template <class T>
+    inline void parallelFor(std::size_t, std::size_t, std::size_t, T &&);
+
+    template <class T>
+    void parallelFor(AsyncLane, std::size_t, std::size_t, std::size_t, T &&);
+
+    // the reducer must be associative and commutative, and the identity must be its identity
+    // element: chunks are folded per worker, and stolen chunks out of index order
+    template <class T, class U, class V>
+    inline T parallelReduce(std::size_t, std::size_t, std::size_t, T, U &&, V &&);
+
+    template <class T, class U, class V>
+    T parallelReduce(AsyncLane, std::size_t, std::size_t, std::size_t, T, U &&, V &&);
+
+    template <class T>
+    void whenAll(T &&);
+
+    template <class T>
+    std::size_t whenAny(T &&);
+
+    explicit Async(Loop *, std::size_t = 0, std::size_t = 0);
     Async(Async &&) noexcept;
     ~Async();
     Async &operator=(Async &&) noexcept;
 
+    void addLane(AsyncLane, std::size_t = 1, std::size_t = 0);
+    void setCPUAffinity(const cpu_set_t &);
     void executeTask(const std::function<void ()> &);
     void executeTask(std::function<void ()> &&);
 
 private:
     typedef detail::AsyncTask Task;
+    typedef detail::AsyncWaiter Waiter;
+    typedef detail::AsyncParallelRange ParallelRange;
 
-    std::unique_ptr<ThreadPool> threadPool_;
+    std::unique_ptr<ThreadPool> threadPools_[detail::NumberOfAsyncLanes];
     Loop *loop_;
-    void *fiberHandle_;
+    void *fiberHandles_[detail::NumberOfAsyncLanes];
     std::size_t taskCount_;
+    ObjectPool<Task> taskPool_;
 
     static void EventTrigger(ThreadPool *, Loop *) noexcept;
 
     void initialize();
     void finalize() noexcept;
     void move(Async *) noexcept;
+    void startLane(std::size_t);
+    ThreadPool *getThreadPool(AsyncLane) noexcept;
+    void executeTask(AsyncLane, void (*)(void *), void *);
+    std::size_t getParallelism(AsyncLane, std::size_t, std::size_t, std::size_t) const noexcept;
+    void executeParallelTasks(AsyncLane, std::size_t, std::size_t, std::size_t, std::size_t
+                              , void (*)(void *, std::size_t, std::size_t, std::size_t), void *);
+    void cancelParallelTasks(ParallelRange *, std::size_t, Waiter *) noexcept;
     void waitForTask(Task *);
+    Task *createTask();
+    void destroyTask(Task *) noexcept;
+    void joinTask(Task *);
+    bool cancelTask(Task *) noexcept;
+    bool waitForCompletedTask(Task *) noexcept;
+
+    template <class T>
+    friend class AsyncFuture;
+};
+
+
+template <class T>
+class AsyncFuture final
+{
+public:
+    inline bool isValid() const noexcept;
+    inline bool isReady() const noexcept;
+
+    AsyncFuture(AsyncFuture &&) noexcept;
+    ~AsyncFuture();
+    AsyncFuture &operator=(AsyncFuture &&) noexcept;
+
+    T get();
+
+private:
+    typedef detail::AsyncTask Task;
+    typedef detail::AsyncResult<T> Result;
+
+    Async *async_;
+    Task *task_;
+
+    inline explicit AsyncFuture(Async *, Task *) noexcept;
+
+    void finalize() noexcept;
+    void move(AsyncFuture *) noexcept;
+
+    friend Async;
 };
 
 } // namespace siren
@@ -65,26 +215,176 @@ private:
 #include <new>
 #include <tuple>
 #include <utility>
+#include <vector>
 
+#include "assert.h"
+#include "loop.h"
+#include "scope_guard.h"
 #include "utility.h"
 
 
 namespace siren {
 
+namespace detail {
+
+AsyncTask::AsyncTask() noexcept
+  : threadPool(nullptr),
+    waiter(nullptr),
+    isCompleted(false),
+    errorNumber(0),
+    procedureDestructor(nullptr)
+{
+}
+
+
+template <class T, std::size_t N>
+struct AsyncStorage<T, N, true>
+{
+    template <class ...U>
+    static void Construct(void *storage, U &&...argument)
+    {
+        new (storage) T(std::forward<U>(argument)...);
+    }
+
+
+    static T *Get(void *storage) noexcept
+    {
+        return static_cast<T *>(storage);
+    }
+
+
+    static void Destroy(void *storage) noexcept
+    {
+        Get(storage)->~T();
+    }
+};
+
+
+template <class T, std::size_t N>
+struct AsyncStorage<T, N, false>
+{
+    template <class ...U>
+    static void Construct(void *storage, U &&...argument)
+    {
+        *static_cast<T **>(storage) = new T(std::forward<U>(argument)...);
+    }
+
+
+    static T *Get(void *storage) noexcept
+    {
+        return *static_cast<T **>(storage);
+    }
+
+
+    static void Destroy(void *storage) noexcept
+    {
+        delete Get(storage);
+    }
+};
+
+
+template <class T>
+struct AsyncResult
+{
+    typedef AsyncStorage<T, sizeof(AsyncTask::result)> Storage;
+
+
+    template <class U>
+    static void Store(AsyncTask *task, U &&function)
+    {
+        Storage::Construct(task->result, std::forward<U>(function)());
+    }
+
+
+    static T Load(AsyncTask *task)
+    {
+        T *result = Storage::Get(task->result);
+
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            Storage::Destroy(task->result);
+        });
+
+        return std::move(*result);
+    }
+
+
+    static void Discard(AsyncTask *task) noexcept
+    {
+        Storage::Destroy(task->result);
+    }
+};
+
+
+template <>
+struct AsyncResult<void>
+{
+    template <class U>
+    static void Store(AsyncTask *, U &&function)
+    {
+        std::forward<U>(function)();
+    }
+
+
+    static void Load(AsyncTask *) noexcept
+    {
+    }
+
+
+    static void Discard(AsyncTask *) noexcept
+    {
+    }
+};
+
+} // namespace detail
+
+
 bool
 Async::isValid() const noexcept
 {
-    return threadPool_ != nullptr && fiberHandle_ != nullptr;
+    return threadPools_[0] != nullptr && fiberHandles_[0] != nullptr;
+}
+
+
+const ThreadPool *
+Async::getThreadPool(AsyncLane lane) const noexcept
+{
+    const std::unique_ptr<ThreadPool> &threadPool = threadPools_[static_cast<std::size_t>(lane)];
+    return threadPool == nullptr ? threadPools_[0].get() : threadPool.get();
+}
+
+
+bool
+Async::CurrentTaskIsCancelled() noexcept
+{
+    return ThreadPool::CurrentTaskIsCancelled();
 }
 
 
 template <class T, class ...U>
 std::enable_if_t<std::is_void<std::result_of_t<T(U ...)>>::value, void>
 Async::callFunction(T &&procedure, U ...argument)
+{
+    callFunction(AsyncLane::Default, std::forward<T>(procedure), std::move(argument)...);
+}
+
+
+template <class T, class ...U>
+std::enable_if_t<!std::is_void<std::result_of_t<T(U ...)>>::value
+                 && !std::is_reference<std::result_of_t<T(U ...)>>::value
+                 , std::result_of_t<T(U ...)>>
+Async::callFunction(T &&function, U ...argument)
+{
+    return callFunction(AsyncLane::Default, std::forward<T>(function), std::move(argument)...);
+}
+
+
+template <class T, class ...U>
+std::enable_if_t<std::is_void<std::result_of_t<T(U ...)>>::value, void>
+Async::callFunction(AsyncLane lane, T &&procedure, U ...argument)
 {
     typedef std::tuple<U ...> V;
 
-    struct {
+    struct Context {
         T &&procedure;
         V arguments;
         int errorNumber;
@@ -94,14 +394,16 @@ Async::callFunction(T &&procedure, U ...argument)
         0,
     };
 
-    executeTask([&context] () -> void {
+    executeTask(lane, [] (void *argument) -> void {
+        auto context = static_cast<Context *>(argument);
+
         struct ErrorNumberCapturer {
             int *errorNumber;
             ~ErrorNumberCapturer() { *errorNumber = errno; }
-        } errorNumberCapturer = {&context.errorNumber};
+        } errorNumberCapturer = {&context->errorNumber};
 
-        ApplyFunction(std::forward<T>(context.procedure), context.arguments);
-    });
+        ApplyFunction(std::forward<T>(context->procedure), context->arguments);
+    }, &context);
 
     errno = context.errorNumber;
 }
@@ -111,12 +413,12 @@ template <class T, class ...U>
 std::enable_if_t<!std::is_void<std::result_of_t<T(U ...)>>::value
                  && !std::is_reference<std::result_of_t<T(U ...)>>::value
                  , std::result_of_t<T(U ...)>>
-Async::callFunction(T &&function, U ...argument)
+Async::callFunction(AsyncLane lane, T &&function, U ...argument)
 {
     typedef std::tuple<U ...> V;
     typedef std::result_of_t<T(U ...)> W;
 
-    struct {
+    struct Context {
         T &&function;
         V arguments;
         alignas(alignof(W)) char result[sizeof(W)];
@@ -128,18 +430,331 @@ Async::callFunction(T &&function, U ...argument)
         0,
     };
 
-    executeTask([&context] () -> void {
+    executeTask(lane, [] (void *argument) -> void {
+        auto context = static_cast<Context *>(argument);
+
         struct ErrorNumberCapturer {
             int *errorNumber;
             ~ErrorNumberCapturer() { *errorNumber = errno; }
-        } errorNumberCapturer = {&context.errorNumber};
+        } errorNumberCapturer = {&context->errorNumber};
 
-        new (context.result) W(ApplyFunction(std::forward<T>(context.function)
-                                             , context.arguments));
-    });
+        new (context->result) W(ApplyFunction(std::forward<T>(context->function)
+                                              , context->arguments));
+    }, &context);
 
     errno = context.errorNumber;
     return *reinterpret_cast<W *>(context.result);
 }
 
+
+template <class T, class ...U>
+std::enable_if_t<!std::is_reference<std::result_of_t<std::decay_t<T>(U ...)>>::value
+                 , AsyncFuture<std::result_of_t<std::decay_t<T>(U ...)>>>
+Async::submit(T &&function, U ...argument)
+{
+    return submit(AsyncLane::Default, std::forward<T>(function), std::move(argument)...);
+}
+
+
+template <class T, class ...U>
+std::enable_if_t<!std::is_reference<std::result_of_t<std::decay_t<T>(U ...)>>::value
+                 , AsyncFuture<std::result_of_t<std::decay_t<T>(U ...)>>>
+Async::submit(AsyncLane lane, T &&function, U ...argument)
+{
+    SIREN_ASSERT(isValid());
+    typedef std::result_of_t<std::decay_t<T>(U ...)> W;
+
+    struct Procedure {
+        std::decay_t<T> function;
+        std::tuple<U ...> arguments;
+    };
+
+    typedef detail::AsyncStorage<Procedure, sizeof(Task::procedure)> X;
+    Task *task = createTask();
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        destroyTask(task);
+    });
+
+    X::Construct(task->procedure, Procedure{std::forward<T>(function), {std::move(argument)...}});
+    task->procedureDestructor = X::Destroy;
+
+    task->threadPool = getThreadPool(lane);
+
+    task->threadPool->addTask(task, [] (void *argument) -> void {
+        auto task = static_cast<Task *>(argument);
+        Procedure *procedure = X::Get(task->procedure);
+
+        struct ErrorNumberCapturer {
+            int *errorNumber;
+            ~ErrorNumberCapturer() { *errorNumber = errno; }
+        } errorNumberCapturer = {&task->errorNumber};
+
+        detail::AsyncResult<W>::Store(task, [&] () -> W {
+            return ApplyFunction(std::move(procedure->function)
+                                 , std::move(procedure->arguments));
+        });
+    }, task);
+
+    scopeGuard.dismiss();
+    return AsyncFuture<W>(this, task);
+}
+
+
+template <class T>
+void
+Async::parallelFor(std::size_t firstIndex, std::size_t lastIndex, std::size_t grainSize
+                   , T &&procedure)
+{
+    parallelFor(AsyncLane::Default, firstIndex, lastIndex, grainSize, std::forward<T>(procedure));
+}
+
+
+template <class T>
+void
+Async::parallelFor(AsyncLane lane, std::size_t firstIndex, std::size_t lastIndex
+                   , std::size_t grainSize, T &&procedure)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(grainSize >= 1);
+
+    struct Context {
+        T &&procedure;
+    } context = {
+        std::forward<T>(procedure),
+    };
+
+    executeParallelTasks(lane, firstIndex, lastIndex, grainSize
+                         , getParallelism(lane, firstIndex, lastIndex, grainSize)
+                         , [] (void *argument, std::size_t, std::size_t firstIndex
+                               , std::size_t lastIndex) -> void {
+        static_cast<Context *>(argument)->procedure(firstIndex, lastIndex);
+    }, &context);
+}
+
+
+template <class T, class U, class V>
+T
+Async::parallelReduce(std::size_t firstIndex, std::size_t lastIndex, std::size_t grainSize
+                      , T identity, U &&mapper, V &&reducer)
+{
+    return parallelReduce(AsyncLane::Default, firstIndex, lastIndex, grainSize
+                          , std::move(identity), std::forward<U>(mapper)
+                          , std::forward<V>(reducer));
+}
+
+
+template <class T, class U, class V>
+T
+Async::parallelReduce(AsyncLane lane, std::size_t firstIndex, std::size_t lastIndex
+                      , std::size_t grainSize, T identity, U &&mapper, V &&reducer)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(grainSize >= 1);
+    std::size_t parallelism = getParallelism(lane, firstIndex, lastIndex, grainSize);
+    // one partial value per worker, so chunks are folded without any synchronization, but in no
+    // particular index order
+    std::vector<T> values(parallelism, identity);
+
+    struct Context {
+        U &&mapper;
+        V &&reducer;
+        std::vector<T> *values;
+    } context = {
+        std::forward<U>(mapper),
+        std::forward<V>(reducer),
+        &values,
+    };
+
+    executeParallelTasks(lane, firstIndex, lastIndex, grainSize, parallelism
+                         , [] (void *argument, std::size_t workerIndex, std::size_t firstIndex
+                               , std::size_t lastIndex) -> void {
+        auto context = static_cast<Context *>(argument);
+        T &value = (*context->values)[workerIndex];
+        value = context->reducer(std::move(value), context->mapper(firstIndex, lastIndex));
+    }, &context);
+
+    for (T &value : values) {
+        identity = reducer(std::move(identity), std::move(value));
+    }
+
+    return identity;
+}
+
+
+template <class T>
+void
+Async::whenAll(T &&futures)
+{
+    Waiter waiter = {loop_->makeEvent(), 0};
+
+    for (auto &future : futures) {
+        SIREN_ASSERT(future.isValid());
+
+        if (!future.task_->isCompleted) {
+            future.task_->waiter = &waiter;
+            ++waiter.taskCount;
+        }
+    }
+
+    if (waiter.taskCount == 0) {
+        return;
+    }
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        for (auto &future : futures) {
+            future.task_->waiter = nullptr;
+        }
+    });
+
+    waiter.event.waitFor();
+}
+
+
+template <class T>
+std::size_t
+Async::whenAny(T &&futures)
+{
+    Waiter waiter = {loop_->makeEvent(), 1};
+    std::size_t i = 0;
+
+    for (auto &future : futures) {
+        SIREN_ASSERT(future.isValid());
+
+        if (future.task_->isCompleted) {
+            return i;
+        }
+
+        ++i;
+    }
+
+    SIREN_ASSERT(i >= 1);
+
+    {
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            for (auto &future : futures) {
+                future.task_->waiter = nullptr;
+            }
+        });
+
+        for (auto &future : futures) {
+            future.task_->waiter = &waiter;
+        }
+
+        waiter.event.waitFor();
+    }
+
+    i = 0;
+
+    for (auto &future : futures) {
+        if (future.task_->isCompleted) {
+            break;
+        }
+
+        ++i;
+    }
+
+    return i;
+}
+
+
+template <class T>
+AsyncFuture<T>::AsyncFuture(Async *async, Task *task) noexcept
+  : async_(async),
+    task_(task)
+{
+}
+
+
+template <class T>
+AsyncFuture<T>::AsyncFuture(AsyncFuture &&other) noexcept
+  : async_(other.async_)
+{
+    other.move(this);
+}
+
+
+template <class T>
+AsyncFuture<T>::~AsyncFuture()
+{
+    finalize();
+}
+
+
+template <class T>
+AsyncFuture<T> &
+AsyncFuture<T>::operator=(AsyncFuture &&other) noexcept
+{
+    if (&other != this) {
+        finalize();
+        async_ = other.async_;
+        other.move(this);
+    }
+
+    return *this;
+}
+
+
+template <class T>
+void
+AsyncFuture<T>::finalize() noexcept
+{
+    if (isValid()) {
+        if (!async_->cancelTask(task_)) {
+            try {
+                task_->check();
+                Result::Discard(task_);
+            } catch (...) {
+            }
+        }
+
+        async_->destroyTask(task_);
+    }
+}
+
+
+template <class T>
+void
+AsyncFuture<T>::move(AsyncFuture *other) noexcept
+{
+    other->task_ = task_;
+    task_ = nullptr;
+}
+
+
+template <class T>
+bool
+AsyncFuture<T>::isValid() const noexcept
+{
+    return task_ != nullptr;
+}
+
+
+template <class T>
+bool
+AsyncFuture<T>::isReady() const noexcept
+{
+    SIREN_ASSERT(isValid());
+    return task_->isCompleted;
+}
+
+
+template <class T>
+T
+AsyncFuture<T>::get()
+{
+    SIREN_ASSERT(isValid());
+    async_->joinTask(task_);
+    Task *task = task_;
+    task_ = nullptr;
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        async_->destroyTask(task);
+    });
+
+    task->check();
+    errno = task->errorNumber;
+    return Result::Load(task);
+}
+
 } // namespace siren
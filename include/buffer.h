@@ -7,6 +7,13 @@
 
 namespace siren {
 
+enum class BufferStorage
+{
+    Heap = 0,
+    Pooled,
+};
+
+
 template <class T, bool = std::is_pod<T>::value>
 class Buffer;
 
@@ -15,7 +22,7 @@ template <class T>
 class Buffer<T, true> final
 {
 public:
-    inline explicit Buffer() noexcept;
+    inline explicit Buffer(BufferStorage = BufferStorage::Heap) noexcept;
     inline Buffer(Buffer &&) noexcept;
     inline ~Buffer();
     inline Buffer &operator=(Buffer &&) noexcept;
@@ -25,16 +32,28 @@ public:
     inline void reset() noexcept;
     inline std::size_t getLength() const noexcept;
     inline void setLength(std::size_t);
+    inline void shrinkLength(std::size_t) noexcept;
 
 private:
+    BufferStorage storage_;
     T *base_;
     std::size_t length_;
 
     inline void initialize() noexcept;
     inline void finalize() noexcept;
     inline void move(Buffer *) noexcept;
+    inline std::size_t getSize() const noexcept;
+    inline T *reallocate(std::size_t);
 };
 
+
+namespace detail {
+
+void *AllocatePooledBlock(std::size_t);
+void FreePooledBlock(void *, std::size_t) noexcept;
+
+} // namespace detail
+
 } // namespace siren
 
 
@@ -43,8 +62,10 @@ private:
  */
 
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <system_error>
 
 #include "utility.h"
@@ -53,7 +74,8 @@ private:
 namespace siren {
 
 template <class T>
-Buffer<T, true>::Buffer() noexcept
+Buffer<T, true>::Buffer(BufferStorage storage) noexcept
+  : storage_(storage)
 {
     initialize();
 }
@@ -61,6 +83,7 @@ Buffer<T, true>::Buffer() noexcept
 
 template <class T>
 Buffer<T, true>::Buffer(Buffer &&other) noexcept
+  : storage_(other.storage_)
 {
     other.move(this);
 }
@@ -79,6 +102,7 @@ Buffer<T, true>::operator=(Buffer &&other) noexcept
 {
     if (&other != this) {
         finalize();
+        storage_ = other.storage_;
         other.move(this);
     }
 
@@ -113,7 +137,13 @@ template <class T>
 void
 Buffer<T, true>::finalize() noexcept
 {
-    std::free(base_);
+    if (storage_ == BufferStorage::Pooled) {
+        if (base_ != nullptr) {
+            detail::FreePooledBlock(base_, getSize());
+        }
+    } else {
+        std::free(base_);
+    }
 }
 
 
@@ -144,6 +174,14 @@ Buffer<T, true>::getLength() const noexcept
 }
 
 
+template <class T>
+std::size_t
+Buffer<T, true>::getSize() const noexcept
+{
+    return NextPowerOfTwo(length_ * sizeof(T));
+}
+
+
 template <class T>
 void
 Buffer<T, true>::setLength(std::size_t length)
@@ -152,17 +190,73 @@ Buffer<T, true>::setLength(std::size_t length)
     T *base;
 
     if (size == 0) {
-        base = (std::free(base_), nullptr);
+        base = (finalize(), nullptr);
     } else {
-        base = static_cast<T *>(std::realloc(base_, size));
+        base = reallocate(size);
+    }
 
-        if (base == nullptr) {
-            throw std::system_error(errno, std::system_category(), "realloc() failed");
-        }
+    base_ = base;
+    length_ = size / sizeof(T);
+}
+
+
+template <class T>
+void
+Buffer<T, true>::shrinkLength(std::size_t length) noexcept
+{
+    std::size_t size = NextPowerOfTwo(length * sizeof(T));
+
+    if (size >= getSize()) {
+        return;
+    }
+
+    if (size == 0) {
+        reset();
+        return;
+    }
+
+    T *base;
+
+    try {
+        base = reallocate(size);
+    } catch (const std::system_error &) {
+        // keep the larger block, it is still valid
+        return;
     }
 
     base_ = base;
     length_ = size / sizeof(T);
 }
 
+
+template <class T>
+T *
+Buffer<T, true>::reallocate(std::size_t size)
+{
+    if (storage_ == BufferStorage::Pooled) {
+        std::size_t oldSize = base_ == nullptr ? 0 : getSize();
+
+        if (size == oldSize) {
+            return base_;
+        }
+
+        auto base = static_cast<T *>(detail::AllocatePooledBlock(size));
+
+        if (base_ != nullptr) {
+            std::memcpy(base, base_, std::min(size, oldSize));
+            detail::FreePooledBlock(base_, oldSize);
+        }
+
+        return base;
+    }
+
+    auto base = static_cast<T *>(std::realloc(base_, size));
+
+    if (base == nullptr) {
+        throw std::system_error(errno, std::system_category(), "realloc() failed");
+    }
+
+    return base;
+}
+
 } // namespace siren
@@ -0,0 +1,42 @@
+#pragma once
+
+
+#include <cstddef>
+#include <memory>
+
+
+namespace siren {
+
+namespace detail {
+
+struct ConcurrentMemoryPoolCache;
+struct ConcurrentMemoryPoolCore;
+
+} // namespace detail
+
+
+class ConcurrentMemoryPool final
+{
+public:
+    void *allocateBlock();
+    void freeBlock(void *) noexcept;
+
+    explicit ConcurrentMemoryPool(std::size_t, std::size_t, std::size_t = 0);
+
+private:
+    typedef detail::ConcurrentMemoryPoolCache Cache;
+    typedef detail::ConcurrentMemoryPoolCore Core;
+
+    const std::shared_ptr<Core> core_;
+
+    Cache *findCache() const noexcept;
+    bool refillCache(Cache *) noexcept;
+    void spillCache(Cache *) noexcept;
+    Cache *getCache();
+    void *makeBlock(Cache *);
+
+    ConcurrentMemoryPool(const ConcurrentMemoryPool &) = delete;
+    ConcurrentMemoryPool &operator=(const ConcurrentMemoryPool &) = delete;
+};
+
+} // namespace siren
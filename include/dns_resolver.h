@@ -0,0 +1,124 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "event.h"
+#include "hash_table.h"
+#include "ip_endpoint.h"
+#include "list.h"
+#include "object_pool.h"
+
+
+namespace siren {
+
+class Async;
+class Loop;
+
+
+namespace detail {
+
+struct DNSCacheEntry
+  : HashTableNode,
+    ListNode
+{
+    std::string hostName;
+    Event event;
+    bool isCached;
+    bool isResolved;
+    int errorCode;
+    std::uint32_t address;
+    std::chrono::steady_clock::time_point expiryTime;
+    std::size_t referenceCount;
+
+    inline explicit DNSCacheEntry(std::string &&, Event &&) noexcept;
+};
+
+} // namespace detail
+
+
+class DNSResolver final
+{
+public:
+    inline std::size_t getNumberOfCachedNames() const noexcept;
+
+    explicit DNSResolver(Loop *, Async * = nullptr, long = 60000, long = 5000, std::size_t = 1024);
+    ~DNSResolver();
+
+    void setNameServer(const IPEndpoint &, long = 1000, int = 2);
+    std::uint32_t resolveName(const char *);
+
+private:
+    typedef detail::DNSCacheEntry CacheEntry;
+
+    Loop *const loop_;
+    Async *const async_;
+    const std::chrono::milliseconds defaultTTL_;
+    const std::chrono::milliseconds negativeTTL_;
+    const std::size_t maxNumberOfCachedNames_;
+    IPEndpoint nameServer_;
+    long queryTimeout_;
+    int maxNumberOfQueries_;
+    std::minstd_rand randomEngine_;
+    ObjectPool<CacheEntry> entryPool_;
+    HashTable entryHashTable_;
+    std::size_t entryCount_;
+
+    static std::size_t HashHostName(const char *, std::size_t) noexcept;
+
+    void initialize();
+    void finalize() noexcept;
+    CacheEntry *findEntry(const char *, std::size_t, std::size_t) noexcept;
+    CacheEntry *createEntry(const char *, std::size_t, std::size_t);
+    void uncacheEntry(CacheEntry *) noexcept;
+    void uncacheEntries(List *) noexcept;
+    void releaseEntry(CacheEntry *) noexcept;
+    void removeExpiredEntries(std::chrono::steady_clock::time_point, bool) noexcept;
+    void resolveEntry(CacheEntry *);
+    int lookUpName(const char *, std::uint32_t *, std::chrono::milliseconds *);
+    int queryNameServer(const char *, std::uint32_t *, std::chrono::milliseconds *);
+
+    DNSResolver(const DNSResolver &) = delete;
+    DNSResolver &operator=(const DNSResolver &) = delete;
+};
+
+} // namespace siren
+
+
+/*
+ * #include "dns_resolver-inl.h"
+ */
+
+
+#include <utility>
+
+
+namespace siren {
+
+namespace detail {
+
+DNSCacheEntry::DNSCacheEntry(std::string &&hostName, Event &&event) noexcept
+  : hostName(std::move(hostName)),
+    event(std::move(event)),
+    isCached(false),
+    isResolved(false),
+    errorCode(0),
+    address(0),
+    referenceCount(0)
+{
+}
+
+} // namespace detail
+
+
+std::size_t
+DNSResolver::getNumberOfCachedNames() const noexcept
+{
+    return entryCount_;
+}
+
+} // namespace siren
@@ -0,0 +1,117 @@
+#pragma once
+
+
+#include <cstddef>
+
+#include "stream.h"
+
+
+namespace siren {
+
+class Archive;
+class TCPSocket;
+
+
+enum class FramePrefix
+{
+    VLI = 0,
+    Fixed32,
+};
+
+
+class FramedConnection final
+{
+public:
+    template <class T>
+    inline std::size_t readFrames(T &&);
+
+    template <class T>
+    inline void writeFrame(const T &);
+
+    explicit FramedConnection(TCPSocket *, FramePrefix = FramePrefix::VLI
+                              , std::size_t = 16 * 1024 * 1024);
+
+    void flush();
+
+private:
+    TCPSocket *const socket_;
+    const FramePrefix framePrefix_;
+    const std::size_t maxFrameSize_;
+    Stream inputStream_;
+    Stream outputStream_;
+
+    bool peekFrame(std::size_t *, std::size_t *);
+    std::size_t readStream();
+    void writeFramePrefix(Archive *, std::size_t);
+
+    FramedConnection(const FramedConnection &) = delete;
+    FramedConnection &operator=(const FramedConnection &) = delete;
+};
+
+} // namespace siren
+
+
+/*
+ * #include "framed_connection-inl.h"
+ */
+
+
+#include <cerrno>
+#include <system_error>
+
+#include "archive.h"
+#include "scope_guard.h"
+
+
+namespace siren {
+
+template <class T>
+std::size_t
+FramedConnection::readFrames(T &&callback)
+{
+    std::size_t headerSize;
+    std::size_t frameSize;
+
+    while (!peekFrame(&headerSize, &frameSize)) {
+        if (readStream() == 0) {
+            return 0;
+        }
+    }
+
+    std::size_t frameCount = 0;
+
+    // hand out every complete frame of this wakeup
+    do {
+        Archive archive(&inputStream_, headerSize);
+        // a short frame must not be decoded with the bytes of the next one
+        archive.setMaxNumberOfPreReadBytes(headerSize + frameSize);
+
+        // the frame boundary is still known, so later frames stay readable whatever happens
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            inputStream_.discardData(headerSize + frameSize);
+        });
+
+        try {
+            callback(&archive);
+        } catch (const EndOfStream &) {
+            throw std::system_error(EBADMSG, std::system_category(), "readFrames() failed");
+        }
+
+        ++frameCount;
+    } while (peekFrame(&headerSize, &frameSize));
+
+    return frameCount;
+}
+
+
+template <class T>
+void
+FramedConnection::writeFrame(const T &frame)
+{
+    Archive archive(&outputStream_);
+    writeFramePrefix(&archive, archive.measure(frame));
+    archive << frame;
+    outputStream_.commitBuffer(archive.getNumberOfPreWrittenBytes());
+}
+
+} // namespace siren
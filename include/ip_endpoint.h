@@ -10,6 +10,7 @@
 namespace siren {
 
 class Async;
+class DNSResolver;
 
 
 class IPEndpoint final
@@ -21,9 +22,11 @@ public:
     inline explicit IPEndpoint(std::uint32_t = 0, std::uint16_t = 0) noexcept;
     inline explicit IPEndpoint(const sockaddr_in &) noexcept;
     inline explicit IPEndpoint(Async *, const char *, const char *);
+    inline explicit IPEndpoint(DNSResolver *, const char *, std::uint16_t);
 
 private:
     static sockaddr_in ResolveName(Async *, const char *, const char *);
+    static std::uint32_t ResolveName(DNSResolver *, const char *);
 };
 
 
@@ -31,6 +34,8 @@ class GAIError final
   : public std::exception
 {
 public:
+    inline int getCode() const noexcept;
+
     explicit GAIError(int) noexcept;
 
     const char *what() const noexcept override;
@@ -71,4 +76,17 @@ IPEndpoint::IPEndpoint(Async *async, const char *hostName, const char *serviceNa
     SIREN_ASSERT(async != nullptr);
 }
 
+
+IPEndpoint::IPEndpoint(DNSResolver *dnsResolver, const char *hostName, std::uint16_t portNumber)
+  : IPEndpoint(ResolveName(dnsResolver, hostName), portNumber)
+{
+}
+
+
+int
+GAIError::getCode() const noexcept
+{
+    return code_;
+}
+
 } // namespace siren
@@ -8,6 +8,7 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include "buffer.h"
 #include "event.h"
 #include "io_clock.h"
 #include "io_poller.h"
@@ -55,13 +56,16 @@ public:
     int getsockopt(int, int, int, void *, socklen_t *) const noexcept;
     int setsockopt(int, int, int, const void *, socklen_t) noexcept;
     int accept4(int, sockaddr *, socklen_t *, int);
+    int tryAccept4(int, sockaddr *, socklen_t *, int);
     int connect(int, const sockaddr *, socklen_t);
     ssize_t recv(int, void *, size_t, int);
     ssize_t send(int, const void *, size_t, int);
     ssize_t recvfrom(int, void *, size_t, int, sockaddr *, socklen_t *);
     ssize_t sendto(int, const void *, size_t, int, const sockaddr *, socklen_t);
+    ssize_t sendmsg(int, const msghdr *, int);
     int close(int) noexcept;
     int poll(pollfd *, nfds_t, int);
+    char *getSpillBuffer(std::size_t *);
 
 private:
     typedef detail::FileOptions FileOptions;
@@ -69,6 +73,7 @@ private:
     IOClock ioClock_;
     IOPoller ioPoller_;
     Scheduler scheduler_;
+    Buffer<char> spillBuffer_;
 
     const FileOptions *getFileOptions(int) const noexcept;
     FileOptions *getFileOptions(int) noexcept;
@@ -77,7 +82,9 @@ private:
     long getEffectiveReadTimeout(int) const noexcept;
     long getEffectiveWriteTimeout(int) const noexcept;
     bool waitForFile(int, IOCondition, IOCondition *, std::chrono::milliseconds);
+    int waitForConnection(int, long);
     void setDelay(std::chrono::milliseconds);
+    int acceptSocket(int, long, sockaddr *, socklen_t *, int);
 
     template <class T, class ...U>
     ssize_t readFile(int, long, T &&, U &&...);
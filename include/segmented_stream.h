@@ -0,0 +1,156 @@
+#pragma once
+
+
+#include <cstddef>
+
+#include <sys/uio.h>
+
+#include "list.h"
+#include "memory_pool.h"
+
+
+namespace siren {
+
+namespace detail {
+
+struct StreamSegment
+  : ListNode
+{
+};
+
+} // namespace detail
+
+
+class SegmentedStream final
+{
+public:
+    inline const void *getData() const noexcept;
+    inline void *getData() noexcept;
+    inline std::size_t getDataSize() const noexcept;
+    inline std::size_t getTotalDataSize() const noexcept;
+    inline void *getBuffer() noexcept;
+    inline std::size_t getBufferSize() const noexcept;
+    inline std::size_t getTotalBufferSize() const noexcept;
+
+    explicit SegmentedStream(std::size_t = 4096) noexcept;
+    SegmentedStream(SegmentedStream &&) noexcept;
+    SegmentedStream &operator=(SegmentedStream &&) noexcept;
+
+    void reset() noexcept;
+    void commitBuffer(std::size_t) noexcept;
+    void discardData(std::size_t) noexcept;
+    void reserveBuffer(std::size_t);
+    void read(void *, std::size_t) noexcept;
+    void write(const void *, std::size_t);
+    int getDataVector(iovec *, int) const noexcept;
+    int getBufferVector(iovec *, int) noexcept;
+
+private:
+    typedef detail::StreamSegment Segment;
+
+    std::size_t segmentCapacity_;
+    MemoryPool segmentPool_;
+    List segmentList_;
+    std::size_t segmentCount_;
+    std::size_t dataOffset_;
+    std::size_t dataSize_;
+    Segment *bufferSegment_;
+    std::size_t bufferOffset_;
+    std::size_t bufferSize_;
+
+    inline static const char *GetSegmentData(const Segment *) noexcept;
+    inline static char *GetSegmentData(Segment *) noexcept;
+
+    void initialize() noexcept;
+    void move(SegmentedStream *) noexcept;
+    void rewind() noexcept;
+};
+
+} // namespace siren
+
+
+/*
+ * #include "segmented_stream-inl.h"
+ */
+
+
+#include <algorithm>
+
+
+namespace siren {
+
+const char *
+SegmentedStream::GetSegmentData(const Segment *segment) noexcept
+{
+    return reinterpret_cast<const char *>(segment + 1);
+}
+
+
+char *
+SegmentedStream::GetSegmentData(Segment *segment) noexcept
+{
+    return reinterpret_cast<char *>(segment + 1);
+}
+
+
+const void *
+SegmentedStream::getData() const noexcept
+{
+    if (dataSize_ == 0) {
+        return nullptr;
+    }
+
+    return GetSegmentData(static_cast<const Segment *>(segmentList_.getHead())) + dataOffset_;
+}
+
+
+void *
+SegmentedStream::getData() noexcept
+{
+    if (dataSize_ == 0) {
+        return nullptr;
+    }
+
+    return GetSegmentData(static_cast<Segment *>(segmentList_.getHead())) + dataOffset_;
+}
+
+
+std::size_t
+SegmentedStream::getDataSize() const noexcept
+{
+    return std::min(dataSize_, segmentCapacity_ - dataOffset_);
+}
+
+
+std::size_t
+SegmentedStream::getTotalDataSize() const noexcept
+{
+    return dataSize_;
+}
+
+
+void *
+SegmentedStream::getBuffer() noexcept
+{
+    if (bufferSize_ == 0) {
+        return nullptr;
+    }
+
+    return GetSegmentData(bufferSegment_) + bufferOffset_;
+}
+
+
+std::size_t
+SegmentedStream::getBufferSize() const noexcept
+{
+    return std::min(bufferSize_, segmentCapacity_ - bufferOffset_);
+}
+
+
+std::size_t
+SegmentedStream::getTotalBufferSize() const noexcept
+{
+    return bufferSize_;
+}
+
+} // namespace siren
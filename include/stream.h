@@ -9,6 +9,13 @@
 
 namespace siren {
 
+enum class StreamStorage
+{
+    Heap = 0,
+    Ring,
+};
+
+
 class Stream final
 {
 public:
@@ -18,9 +25,13 @@ public:
     inline void *getBuffer(std::size_t = 0) noexcept;
     inline std::size_t getBufferSize() const noexcept;
     inline void commitBuffer(std::size_t) noexcept;
+#ifdef SIREN_WITH_DEBUG
+    inline std::size_t getGeneration() const noexcept;
+#endif
 
-    explicit Stream() noexcept;
+    explicit Stream(StreamStorage = StreamStorage::Heap) noexcept;
     Stream(Stream &&) noexcept;
+    ~Stream();
     Stream &operator=(Stream &&) noexcept;
 
     void reset() noexcept;
@@ -30,12 +41,25 @@ public:
     void write(const void *, std::size_t);
 
 private:
+    StreamStorage storage_;
     Buffer<char> base_;
+    char *ring_;
+    std::size_t ringSize_;
+    char *data_;
     std::size_t dataOffset_;
     std::size_t bufferOffset_;
+    std::size_t bufferLimit_;
+    std::size_t peakDataSize_;
+    int idleCount_;
+#ifdef SIREN_WITH_DEBUG
+    std::size_t generation_;
+#endif
 
     void initialize() noexcept;
+    void finalize() noexcept;
     void move(Stream *) noexcept;
+    void reserveRing(std::size_t);
+    void shrinkBase() noexcept;
 };
 
 
@@ -64,14 +88,14 @@ namespace siren {
 const void *
 Stream::getData(std::size_t offset) const noexcept
 {
-    return base_ + dataOffset_ + offset;
+    return data_ + dataOffset_ + offset;
 }
 
 
 void *
 Stream::getData(std::size_t offset) noexcept
 {
-    return base_ + dataOffset_ + offset;
+    return data_ + dataOffset_ + offset;
 }
 
 
@@ -85,22 +109,31 @@ Stream::getDataSize() const noexcept
 void *
 Stream::getBuffer(std::size_t offset) noexcept
 {
-    return base_ + bufferOffset_ + offset;
+    return data_ + bufferOffset_ + offset;
 }
 
 
 std::size_t
 Stream::getBufferSize() const noexcept
 {
-    return base_.getLength() - bufferOffset_;
+    return bufferLimit_ - bufferOffset_;
 }
 
 
 void
 Stream::commitBuffer(std::size_t bufferSize) noexcept
 {
-    SIREN_ASSERT(bufferOffset_ + bufferSize <= base_.getLength());
+    SIREN_ASSERT(bufferOffset_ + bufferSize <= bufferLimit_);
     bufferOffset_ += bufferSize;
 }
 
+
+#ifdef SIREN_WITH_DEBUG
+std::size_t
+Stream::getGeneration() const noexcept
+{
+    return generation_;
+}
+#endif
+
 } // namespace siren
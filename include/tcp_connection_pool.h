@@ -0,0 +1,122 @@
+#pragma once
+
+
+#include <cstddef>
+#include <chrono>
+
+#include "hash_table.h"
+#include "ip_endpoint.h"
+#include "list.h"
+#include "object_pool.h"
+#include "semaphore.h"
+#include "tcp_socket.h"
+
+
+namespace siren {
+
+class Loop;
+
+
+namespace detail {
+
+struct TCPConnectionPoolSlot
+  : HashTableNode,
+    ListNode
+{
+    IPEndpoint ipEndpoint;
+    Semaphore semaphore;
+    List idleConnectionList;
+    std::size_t numberOfBusyConnections;
+    std::size_t numberOfIdleConnections;
+
+    inline explicit TCPConnectionPoolSlot(const IPEndpoint &, Semaphore &&) noexcept;
+};
+
+
+struct TCPIdleConnection
+  : ListNode
+{
+    TCPSocket socket;
+    std::chrono::steady_clock::time_point idleTime;
+
+    inline explicit TCPIdleConnection(TCPSocket &&) noexcept;
+};
+
+} // namespace detail
+
+
+class TCPConnectionPool final
+{
+public:
+    explicit TCPConnectionPool(Loop *, std::size_t = 0, std::size_t = 0, std::size_t = 0
+                               , long = -1);
+    ~TCPConnectionPool();
+
+    TCPSocket acquireConnection(const IPEndpoint &);
+    void releaseConnection(const IPEndpoint &, TCPSocket &&, bool = true);
+    std::size_t getNumberOfIdleConnections(const IPEndpoint &) const noexcept;
+
+private:
+    typedef detail::TCPConnectionPoolSlot Slot;
+    typedef detail::TCPIdleConnection IdleConnection;
+
+    Loop *const loop_;
+    const std::size_t maxNumberOfConnections_;
+    const std::size_t minNumberOfIdleConnections_;
+    const std::size_t maxNumberOfIdleConnections_;
+    const std::chrono::milliseconds idleTimeout_;
+    ObjectPool<Slot> slotPool_;
+    ObjectPool<IdleConnection> idleConnectionPool_;
+    HashTable slotHashTable_;
+    void *fiberHandle_;
+
+    static std::size_t HashIPEndpoint(const IPEndpoint &) noexcept;
+
+    void initialize();
+    void finalize() noexcept;
+    const Slot *findSlot(const IPEndpoint &) const noexcept;
+    Slot *findSlot(const IPEndpoint &) noexcept;
+    Slot *getSlot(const IPEndpoint &);
+    void destroySlot(Slot *) noexcept;
+    void destroySlots(List *) noexcept;
+    bool connectionIsAlive(const TCPSocket &) noexcept;
+    void idleConnectionReaper() noexcept;
+    void removeExpiredIdleConnections(Slot *, std::chrono::steady_clock::time_point) noexcept;
+
+    TCPConnectionPool(const TCPConnectionPool &) = delete;
+    TCPConnectionPool &operator=(const TCPConnectionPool &) = delete;
+};
+
+} // namespace siren
+
+
+/*
+ * #include "tcp_connection_pool-inl.h"
+ */
+
+
+#include <utility>
+
+
+namespace siren {
+
+namespace detail {
+
+TCPConnectionPoolSlot::TCPConnectionPoolSlot(const IPEndpoint &ipEndpoint
+                                             , Semaphore &&semaphore) noexcept
+  : ipEndpoint(ipEndpoint),
+    semaphore(std::move(semaphore)),
+    numberOfBusyConnections(0),
+    numberOfIdleConnections(0)
+{
+}
+
+
+TCPIdleConnection::TCPIdleConnection(TCPSocket &&socket) noexcept
+  : socket(std::move(socket))
+{
+}
+
+} // namespace detail
+
+} // namespace siren
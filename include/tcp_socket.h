@@ -2,6 +2,7 @@
 
 
 #include <cstddef>
+#include <vector>
 
 #include "ip_endpoint.h"
 
@@ -9,6 +10,7 @@
 namespace siren {
 
 class Loop;
+class SegmentedStream;
 class Stream;
 
 
@@ -18,12 +20,22 @@ public:
     inline bool isValid() const noexcept;
     inline int getFD() const noexcept;
 
+    template <class T>
+    inline std::size_t acceptAll(T &&, std::size_t = 0);
+
+    // the shards are registered with their loops from the calling thread, so it must be called
+    // before those loops start running on their own threads
+    static std::vector<TCPSocket> ListenShards(const std::vector<Loop *> &, const IPEndpoint &
+                                               , bool = false, int = 511);
+
     explicit TCPSocket(Loop *);
     TCPSocket(TCPSocket &&) noexcept;
     ~TCPSocket();
     TCPSocket &operator=(TCPSocket &&) noexcept;
 
     void setReuseAddress(bool);
+    void setReusePort(bool);
+    void setReusePortCPUAffinity(unsigned int);
     void setNoDelay(bool);
     void setLinger(bool, int);
     void setKeepAlive(bool, int);
@@ -31,21 +43,29 @@ public:
     void setSendTimeout(long);
     void setReceiveBufferSize(int);
     void setSendBufferSize(int);
+    void setFastOpen(int);
+    void setFastOpenConnect(bool);
+    void setDeferAccept(int);
     void listen(const IPEndpoint &, int = 511);
     TCPSocket accept(IPEndpoint * = nullptr);
+    TCPSocket tryAccept(IPEndpoint * = nullptr);
     void connect(const IPEndpoint &);
+    std::size_t connectAndWrite(const IPEndpoint &, const void *, std::size_t);
     IPEndpoint getLocalEndpoint() const;
     IPEndpoint getRemoteEndpoint() const;
     std::size_t read(void *, std::size_t);
     std::size_t write(const void *, std::size_t);
     std::size_t read(Stream *);
     std::size_t write(Stream *);
+    std::size_t read(SegmentedStream *);
+    std::size_t write(SegmentedStream *);
     void closeRead();
     void closeWrite();
 
 private:
     Loop *loop_;
     int fd_;
+    std::size_t expectedReadSize_;
 
     explicit TCPSocket(Loop *, int) noexcept;
 
@@ -62,6 +82,11 @@ private:
  */
 
 
+#include <utility>
+
+#include "assert.h"
+
+
 namespace siren {
 
 bool
@@ -77,4 +102,28 @@ TCPSocket::getFD() const noexcept
     return fd_;
 }
 
+
+template <class T>
+std::size_t
+TCPSocket::acceptAll(T &&callback, std::size_t maxNumberOfSubSockets)
+{
+    SIREN_ASSERT(isValid());
+    IPEndpoint ipEndpoint;
+    callback(accept(&ipEndpoint), ipEndpoint);
+    std::size_t subSocketCount = 1;
+
+    while (subSocketCount != maxNumberOfSubSockets) {
+        TCPSocket subSocket = tryAccept(&ipEndpoint);
+
+        if (!subSocket.isValid()) {
+            break;
+        }
+
+        callback(std::move(subSocket), ipEndpoint);
+        ++subSocketCount;
+    }
+
+    return subSocketCount;
+}
+
 } // namespace siren
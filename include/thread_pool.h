@@ -3,13 +3,15 @@
 
 #include <cstddef>
 #include <atomic>
-#include <condition_variable>
-#include <functional>
+#include <chrono>
+#include <exception>
+#include <memory>
 #include <mutex>
 #include <thread>
-#include <type_traits>
 #include <vector>
 
+#include <sched.h>
+
 #include "config.h"
 #include "list.h"
 
@@ -17,9 +19,21 @@
 namespace siren {
 
 class ThreadPool;
+class ThreadPoolTask;
 namespace detail { enum class ThreadPoolTaskState; }
 
 
+namespace detail {
+
+struct ThreadPoolCell
+{
+    std::atomic<std::size_t> sequenceNumber;
+    std::atomic<ThreadPoolTask *> task;
+};
+
+} // namespace detail
+
+
 class ThreadPoolTask
   : private ListNode
 {
@@ -34,9 +48,14 @@ protected:
 private:
     typedef detail::ThreadPoolTaskState State;
 
-    std::atomic<State> state_;
+    State state_;
+    detail::ThreadPoolCell *cell_;
     bool isWaiting_;
-    std::function<void ()> procedure_;
+    std::atomic<bool> isCancelled_;
+    ThreadPoolTask *nextCompleted_;
+    void (*function_)(void *);
+    void *argument_;
+    std::chrono::steady_clock::time_point enqueueTime_;
     std::exception_ptr exception_;
 
     ThreadPoolTask(const ThreadPoolTask &) = delete;
@@ -52,40 +71,83 @@ public:
     typedef ThreadPoolTask Task;
 
     inline int getEventFD() const noexcept;
+    inline std::size_t getNumberOfThreads() const noexcept;
+    inline std::size_t getNumberOfBusyThreads() const noexcept;
+    inline std::size_t getNumberOfWaitingTasks() const noexcept;
+    inline std::size_t getNumberOfExecutedTasks() const noexcept;
+    inline std::chrono::nanoseconds getTotalWaitTime() const noexcept;
+    inline std::chrono::nanoseconds getTotalBusyTime() const noexcept;
+    inline std::size_t getWaitTimeHistogram(std::size_t) const noexcept;
 
-    template <class T>
-    inline std::enable_if_t<!std::is_same<T, nullptr_t>::value, void> addTask(Task *, T &&);
+    inline void addTask(Task *, void (*)(void *), void *);
 
     template <class T>
     void removeCompletedTasks(T &&);
 
-    explicit ThreadPool(std::size_t = 0);
+    explicit ThreadPool(std::size_t = 0, std::size_t = 0, long = 10000, long = 10);
     ~ThreadPool();
 
-    void removeTask(Task *, bool *) noexcept;
+    static bool CurrentTaskIsCancelled() noexcept;
+
+    bool removeTask(Task *) noexcept;
+    void getCPUAffinity(cpu_set_t *) const noexcept;
+    void setCPUAffinity(const cpu_set_t &);
 
 private:
     typedef detail::ThreadPoolTaskState TaskState;
-
-    Task noListNode_;
-    List waitingTaskList_;
+    typedef detail::ThreadPoolCell Cell;
+
+    const std::size_t minNumberOfThreads_;
+    const std::size_t maxNumberOfThreads_;
+    const std::chrono::milliseconds idleTimeout_;
+    const std::chrono::milliseconds maxQueueDelay_;
+    std::unique_ptr<Cell []> cells_;
+    std::size_t cellIndexMask_;
+    std::atomic<std::size_t> enqueueCount_;
+    std::atomic<std::size_t> dequeueCount_;
+    std::mutex mutex_;
+    List overflowedTaskList_;
+    std::atomic<std::size_t> overflowedTaskCount_;
+    std::atomic<int> futex_;
+    std::atomic<std::size_t> idleWorkerCount_;
+    std::atomic<bool> isStopped_;
+    std::atomic<Task *> completedTaskStack_;
     List completedTaskList_;
     int eventFD_;
-    std::mutex mutexes_[2];
-    std::condition_variable conditionVariable_;
+    mutable std::mutex threadMutex_;
     std::vector<std::thread> threads_;
+    cpu_set_t cpuSet_;
+    std::vector<std::thread::id> retiredThreadIDs_;
+    std::atomic<std::size_t> threadCount_;
+    std::atomic<std::size_t> busyThreadCount_;
+    std::atomic<std::size_t> executedTaskCount_;
+    std::atomic<std::chrono::nanoseconds::rep> totalWaitTime_;
+    std::atomic<std::chrono::nanoseconds::rep> totalBusyTime_;
+    std::atomic<std::chrono::steady_clock::rep> lastDequeueTime_;
+    std::atomic<std::size_t> waitTimeHistogram_[32];
 
     void initialize();
     void finalize() noexcept;
     void start(std::size_t);
     void stop() noexcept;
     void worker() noexcept;
+    void spawnWorker() noexcept;
+    int bindWorker(std::thread *) noexcept;
+    bool retireWorker() noexcept;
+    void adjustNumberOfThreads(std::chrono::steady_clock::duration) noexcept;
+    void recordWaitTime(std::chrono::steady_clock::duration) noexcept;
+    void executeTask(Task *) noexcept;
     void addWaitingTask(Task *);
     bool removeWaitingTask(Task *) noexcept;
     Task *removeWaitingTask() noexcept;
-    void noMoreWaitingTasks();
-    void addCompletedTask(Task *);
-    void removeCompletedTask(Task *) noexcept;
+    bool enqueueTask(Task *) noexcept;
+    Task *dequeueTask() noexcept;
+    bool hasWaitingTasks() const noexcept;
+    void wakeWorkers(int) noexcept;
+    bool waitForTasks() noexcept;
+    void noMoreWaitingTasks() noexcept;
+    bool addCompletedTask(Task *) noexcept;
+    void flushCompletedTasks() noexcept;
 
     ThreadPool(const ThreadPool &) = delete;
     ThreadPool &operator=(const ThreadPool &) = delete;
@@ -137,14 +199,69 @@ ThreadPool::getEventFD() const noexcept
 }
 
 
-template <class T>
-std::enable_if_t<!std::is_same<T, nullptr_t>::value, void>
-ThreadPool::addTask(Task *task, T &&procedure)
+std::size_t
+ThreadPool::getNumberOfThreads() const noexcept
+{
+    return threadCount_.load(std::memory_order_relaxed);
+}
+
+
+std::size_t
+ThreadPool::getNumberOfBusyThreads() const noexcept
+{
+    return busyThreadCount_.load(std::memory_order_relaxed);
+}
+
+
+std::size_t
+ThreadPool::getNumberOfWaitingTasks() const noexcept
+{
+    std::size_t dequeueCount = dequeueCount_.load(std::memory_order_relaxed);
+    std::size_t enqueueCount = enqueueCount_.load(std::memory_order_relaxed);
+    return enqueueCount - dequeueCount + overflowedTaskCount_.load(std::memory_order_relaxed);
+}
+
+
+std::size_t
+ThreadPool::getNumberOfExecutedTasks() const noexcept
+{
+    return executedTaskCount_.load(std::memory_order_relaxed);
+}
+
+
+std::chrono::nanoseconds
+ThreadPool::getTotalWaitTime() const noexcept
+{
+    return std::chrono::nanoseconds(totalWaitTime_.load(std::memory_order_relaxed));
+}
+
+
+std::chrono::nanoseconds
+ThreadPool::getTotalBusyTime() const noexcept
+{
+    return std::chrono::nanoseconds(totalBusyTime_.load(std::memory_order_relaxed));
+}
+
+
+std::size_t
+ThreadPool::getWaitTimeHistogram(std::size_t bucketIndex) const noexcept
+{
+    SIREN_ASSERT(bucketIndex < sizeof(waitTimeHistogram_) / sizeof(waitTimeHistogram_[0]));
+    return waitTimeHistogram_[bucketIndex].load(std::memory_order_relaxed);
+}
+
+
+void
+ThreadPool::addTask(Task *task, void (*function)(void *), void *argument)
 {
     SIREN_ASSERT(task != nullptr);
-    SIREN_ASSERT(task->state_.load(std::memory_order_relaxed) == TaskState::Initial);
-    task->state_.store(TaskState::Uncompleted, std::memory_order_relaxed);
-    task->procedure_ = std::forward<T>(procedure);
+    SIREN_ASSERT(function != nullptr);
+    SIREN_ASSERT(task->state_ == TaskState::Initial);
+    task->function_ = function;
+    task->argument_ = argument;
+    task->enqueueTime_ = std::chrono::steady_clock::now();
+    task->state_ = TaskState::Uncompleted;
+    task->isCancelled_.store(false, std::memory_order_relaxed);
     addWaitingTask(task);
 }
 
@@ -153,17 +270,11 @@ template <class T>
 void
 ThreadPool::removeCompletedTasks(T &&callback)
 {
-    List list;
-
-    {
-        std::lock_guard<std::mutex> lockGuard(mutexes_[1]);
-        list = std::move(completedTaskList_);
-    }
-
+    flushCompletedTasks();
+    List list = std::move(completedTaskList_);
     Task *task;
 
     auto scopeGuard = MakeScopeGuard([&] () -> void {
-        std::lock_guard<std::mutex> lockGuard(mutexes_[1]);
         completedTaskList_.prependNodes(list.getHead(), task);
     });
 
@@ -1,10 +1,26 @@
 #include "archive.h"
 
+#include <cerrno>
 #include <cstring>
+#include <limits>
+#include <system_error>
 
 
 namespace siren {
 
+namespace {
+
+std::uint32_t MultiplyCRC32C(std::uint32_t, std::uint32_t) noexcept;
+std::uint32_t ShiftCRC32C(std::uint32_t, std::size_t) noexcept;
+std::uint32_t ComputeCRC32CByTable(std::uint32_t, const unsigned char *, std::size_t) noexcept;
+#ifdef __x86_64__
+__attribute__((target("sse4.2")))
+std::uint32_t ComputeCRC32CBySSE42(std::uint32_t, const unsigned char *, std::size_t) noexcept;
+#endif
+
+} // namespace
+
+
 Archive::Archive(Stream *stream, std::size_t numberOfPreReadBytes
                  , std::size_t numberOfPreWrittenBytes) noexcept
 {
@@ -35,8 +51,15 @@ Archive::initialize(Stream *stream, std::size_t numberOfPreReadBytes
                     , std::size_t numberOfPreWrittenBytes) noexcept
 {
     stream_ = stream;
+    mode_ = Mode::Normal;
+    isTagged_ = false;
     preReadByteCount_ = numberOfPreReadBytes;
+    maxPreReadByteCount_ = std::numeric_limits<std::size_t>::max();
     preWrittenByteCount_ = numberOfPreWrittenBytes;
+    checksumIsEnabled_ = false;
+    readChecksum_ = 0;
+    writeChecksum_ = 0;
+    checksumWriteOffset_ = numberOfPreWrittenBytes;
 }
 
 
@@ -45,60 +68,150 @@ Archive::move(Archive *other) noexcept
 {
     other->stream_ = stream_;
     stream_ = nullptr;
+    other->mode_ = mode_;
+    other->isTagged_ = isTagged_;
     other->preReadByteCount_ = preReadByteCount_;
+    other->maxPreReadByteCount_ = maxPreReadByteCount_;
     other->preWrittenByteCount_ = preWrittenByteCount_;
+    other->checksumIsEnabled_ = checksumIsEnabled_;
+    other->readChecksum_ = readChecksum_;
+    other->writeChecksum_ = writeChecksum_;
+    other->checksumWriteOffset_ = checksumWriteOffset_;
 }
 
 
 void
 Archive::serializeVariableLengthInteger(std::uintmax_t integer)
+{
+    if (mode_ == Mode::Sizing) {
+        unsigned char buffer[MaxVariableLengthIntegerSize];
+        preWrittenByteCount_ += EncodeVariableLengthInteger(integer, buffer);
+        return;
+    }
+
+    if (mode_ == Mode::Normal) {
+        stream_->reserveBuffer(preWrittenByteCount_ + MaxVariableLengthIntegerSize);
+    }
+
+    auto buffer = static_cast<unsigned char *>(stream_->getBuffer(preWrittenByteCount_));
+    std::size_t n = EncodeVariableLengthInteger(integer, buffer);
+    updateWriteChecksum(n);
+    preWrittenByteCount_ += n;
+}
+
+
+void
+Archive::deserializeVariableLengthInteger(std::uintmax_t *integer)
+{
+    if (getDataSize() <= preReadByteCount_) {
+        throw EndOfStream();
+    }
+
+    auto data = static_cast<const unsigned char *>(stream_->getData(preReadByteCount_));
+    std::size_t n = DecodeVariableLengthInteger(data, getDataSize() - preReadByteCount_
+                                                , integer);
+
+    if (n == 0) {
+        throw EndOfStream();
+    }
+
+    updateReadChecksum(n);
+    preReadByteCount_ += n;
+}
+
+
+std::size_t
+Archive::EncodeVariableLengthInteger(std::uintmax_t integer, unsigned char *buffer) noexcept
 {
     constexpr unsigned int k1 = std::numeric_limits<std::uintmax_t>::digits;
     constexpr unsigned int k2 = std::numeric_limits<unsigned char>::digits - 1;
     constexpr unsigned char k3 = std::numeric_limits<unsigned char>::max() >> 1;
 
-    serializeInteger<unsigned char>(integer & k3);
+    std::size_t i = 0;
+    buffer[i++] = integer & k3;
 
     for (unsigned int n = k1 - k2; UnsignedToSigned(n) >= 1; n -= k2) {
         if ((((integer >> k2) ^ (integer >> (k2 - 1))) & ((UINTMAX_C(1) << n) - 1)) == 0) {
-            auto buffer = static_cast<unsigned char *>(stream_->getBuffer(preWrittenByteCount_
-                                                                          - 1));
-            *buffer |= k3 + 1;
-            return;
+            buffer[i - 1] |= k3 + 1;
+            break;
         } else {
-            serializeInteger<unsigned char>((integer >>= k2) & k3);
+            buffer[i++] = (integer >>= k2) & k3;
         }
     }
+
+    return i;
 }
 
 
-void
-Archive::deserializeVariableLengthInteger(std::uintmax_t *integer)
+std::size_t
+Archive::DecodeVariableLengthInteger(const unsigned char *data, std::size_t dataSize
+                                     , std::uintmax_t *integer) noexcept
 {
     constexpr unsigned int k1 = std::numeric_limits<std::uintmax_t>::digits;
     constexpr unsigned int k2 = std::numeric_limits<unsigned char>::digits - 1;
     constexpr unsigned char k3 = std::numeric_limits<unsigned char>::max() >> 1;
 
-    unsigned char temp;
-    *integer = (deserializeInteger(&temp), temp & k3);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (k1 == 64 && dataSize >= 8) {
+        // find the last byte from the stop bits of 8 bytes at once, then gather the 7-bit
+        // groups with shifts and masks instead of a loop
+        std::uint64_t x;
+        std::memcpy(&x, data, 8);
+        std::uint64_t stopBits = x & UINT64_C(0x8080808080808080);
+
+        if (stopBits != 0) {
+            unsigned int numberOfBytes = (__builtin_ctzll(stopBits) >> 3) + 1;
+
+            if (numberOfBytes < 8) {
+                x &= (UINT64_C(1) << (8 * numberOfBytes)) - 1;
+            }
+
+            x &= UINT64_C(0x7F7F7F7F7F7F7F7F);
+            x = (x & UINT64_C(0x007F007F007F007F)) | ((x & UINT64_C(0x7F007F007F007F00)) >> 1);
+            x = (x & UINT64_C(0x00003FFF00003FFF)) | ((x & UINT64_C(0x3FFF00003FFF0000)) >> 2);
+            x = (x & UINT64_C(0x000000000FFFFFFF)) | ((x & UINT64_C(0x0FFFFFFF00000000)) >> 4);
+            *integer = x | -(x & (UINT64_C(1) << (k2 * numberOfBytes - 1)));
+            return numberOfBytes;
+        }
+    }
+#endif
+
+    if (dataSize == 0) {
+        return 0;
+    }
+
+    std::size_t i = 0;
+    unsigned char temp = data[i++];
+    *integer = temp & k3;
 
     for (unsigned int n = k2; n < k1; n += k2) {
         if ((temp & (k3 + 1)) == k3 + 1) {
             *integer |= -(*integer & (UINTMAX_C(1) << (n - 1)));
-            return;
+            break;
         } else {
-            *integer |= static_cast<std::uintmax_t>(deserializeInteger(&temp), temp & k3) << n;
+            if (i == dataSize) {
+                return 0;
+            }
+
+            temp = data[i++];
+            *integer |= static_cast<std::uintmax_t>(temp & k3) << n;
         }
     }
+
+    return i;
 }
 
 
 void
 Archive::serializeBytes(const void *bytes, std::size_t numberOfBytes)
 {
-    stream_->reserveBuffer(preWrittenByteCount_ + numberOfBytes);
+    if (!reserveBuffer(numberOfBytes)) {
+        return;
+    }
+
     void *buffer = stream_->getBuffer(preWrittenByteCount_);
     std::memcpy(buffer, bytes, numberOfBytes);
+    updateWriteChecksum(numberOfBytes);
     preWrittenByteCount_ += numberOfBytes;
 }
 
@@ -106,13 +219,305 @@ Archive::serializeBytes(const void *bytes, std::size_t numberOfBytes)
 void
 Archive::deserializeBytes(void *bytes, std::size_t numberOfBytes)
 {
-    if (stream_->getDataSize() < preReadByteCount_ + numberOfBytes) {
+    // lengths come from the wire, so the sum could wrap
+    if (numberOfBytes > getDataSize() - preReadByteCount_) {
         throw EndOfStream();
     }
 
     void *data = stream_->getData(preReadByteCount_);
     std::memcpy(bytes, data, numberOfBytes);
+    updateReadChecksum(numberOfBytes);
     preReadByteCount_ += numberOfBytes;
 }
 
+
+const void *
+Archive::viewBytes(std::size_t numberOfBytes)
+{
+    // lengths come from the wire, so the sum could wrap
+    if (numberOfBytes > getDataSize() - preReadByteCount_) {
+        throw EndOfStream();
+    }
+
+    const void *data = stream_->getData(preReadByteCount_);
+    updateReadChecksum(numberOfBytes);
+    preReadByteCount_ += numberOfBytes;
+    return data;
+}
+
+
+const void *
+Archive::viewElements(std::uintmax_t numberOfElements, std::size_t elementSize)
+{
+    if (numberOfElements > std::numeric_limits<std::size_t>::max() / elementSize) {
+        throw std::system_error(EBADMSG, std::system_category(), "viewElements() failed");
+    }
+
+    return viewBytes(numberOfElements * elementSize);
+}
+
+
+void
+Archive::beginChecksum() noexcept
+{
+    checksumIsEnabled_ = true;
+    readChecksum_ = ~UINT32_C(0);
+    writeChecksum_ = ~UINT32_C(0);
+    checksumWriteOffset_ = preWrittenByteCount_;
+}
+
+
+void
+Archive::serializeChecksum()
+{
+    SIREN_ASSERT(checksumIsEnabled_);
+    serializeInteger(~writeChecksum_);
+    writeChecksum_ = ~UINT32_C(0);
+    checksumWriteOffset_ = preWrittenByteCount_;
+}
+
+
+void
+Archive::deserializeChecksum()
+{
+    SIREN_ASSERT(checksumIsEnabled_);
+    std::uint32_t checksum = ~readChecksum_;
+    std::uint32_t expectedChecksum;
+    deserializeInteger(&expectedChecksum);
+
+    if (checksum != expectedChecksum) {
+        throw std::system_error(EBADMSG, std::system_category(), "deserializeChecksum() failed");
+    }
+
+    readChecksum_ = ~UINT32_C(0);
+}
+
+
+std::uint32_t
+Archive::UpdateChecksum(std::uint32_t checksum, const void *bytes, std::size_t numberOfBytes)
+    noexcept
+{
+    auto temp = static_cast<const unsigned char *>(bytes);
+#ifdef __x86_64__
+    static const bool sse42IsSupported = __builtin_cpu_supports("sse4.2");
+
+    if (sse42IsSupported) {
+        return ComputeCRC32CBySSE42(checksum, temp, numberOfBytes);
+    }
+#endif
+    return ComputeCRC32CByTable(checksum, temp, numberOfBytes);
+}
+
+
+void
+Archive::serializeFieldKey(unsigned int fieldNumber, WireType wireType)
+{
+    serializeVariableLengthInteger(static_cast<std::uintmax_t>(fieldNumber) << 3
+                                   | static_cast<unsigned int>(wireType));
+}
+
+
+unsigned int
+Archive::peekFieldKey(WireType *wireType, std::size_t *keySize)
+{
+    if (getDataSize() <= preReadByteCount_) {
+        throw EndOfStream();
+    }
+
+    auto data = static_cast<const unsigned char *>(stream_->getData(preReadByteCount_));
+    std::uintmax_t key;
+    std::size_t n = DecodeVariableLengthInteger(data, getDataSize() - preReadByteCount_
+                                                , &key);
+
+    if (n == 0) {
+        throw EndOfStream();
+    }
+
+    // a truncated field number could alias the end of a structure or a declared field
+    if (key >> 3 > std::numeric_limits<unsigned int>::max()) {
+        throw std::system_error(EBADMSG, std::system_category(), "peekFieldKey() failed");
+    }
+
+    *wireType = static_cast<WireType>(key & 7);
+    *keySize = n;
+    return key >> 3;
+}
+
+
+std::size_t
+Archive::beginBlock()
+{
+    std::size_t blockOffset = preWrittenByteCount_;
+    serializeInteger<std::uint32_t>(0);
+    return blockOffset;
+}
+
+
+void
+Archive::endBlock(std::size_t blockOffset) noexcept
+{
+    if (mode_ == Mode::Sizing) {
+        return;
+    }
+
+    std::uint32_t blockSize = preWrittenByteCount_ - blockOffset - sizeof(blockSize);
+    auto buffer = static_cast<unsigned char *>(stream_->getBuffer(blockOffset));
+
+    for (std::size_t i = 0; i < sizeof(blockSize); ++i) {
+        buffer[i] = blockSize >> (8 * i);
+    }
+
+    // the zeros folded in at beginBlock() are patched, the CRC being linear the patch can be folded
+    // in as well: it is the CRC of the size, moved past the block contents
+    if (checksumIsEnabled_ && blockOffset >= checksumWriteOffset_) {
+        writeChecksum_ ^= ShiftCRC32C(UpdateChecksum(0, buffer, sizeof(blockSize)), blockSize);
+    }
+}
+
+
+std::size_t
+Archive::deserializeBlock()
+{
+    std::uint32_t blockSize;
+    deserializeInteger(&blockSize);
+
+    if (getDataSize() < preReadByteCount_ + blockSize) {
+        throw EndOfStream();
+    }
+
+    return preReadByteCount_ + blockSize;
+}
+
+
+void
+Archive::skipBlock(std::size_t blockEnd)
+{
+    if (preReadByteCount_ > blockEnd) {
+        throw std::system_error(EBADMSG, std::system_category(), "skipBlock() failed");
+    }
+
+    updateReadChecksum(blockEnd - preReadByteCount_);
+    preReadByteCount_ = blockEnd;
+}
+
+
+void
+Archive::skipField(WireType wireType)
+{
+    std::uintmax_t temp;
+
+    switch (wireType) {
+    case WireType::VLI:
+        deserializeVariableLengthInteger(&temp);
+        return;
+
+    case WireType::Fixed1:
+    case WireType::Fixed2:
+    case WireType::Fixed4:
+    case WireType::Fixed8:
+        viewBytes(std::size_t(1) << (static_cast<int>(wireType)
+                                     - static_cast<int>(WireType::Fixed1)));
+        return;
+
+    case WireType::Block:
+        skipBlock(deserializeBlock());
+        return;
+
+    default:
+        throw std::system_error(EBADMSG, std::system_category(), "skipField() failed");
+    }
+}
+
+
+namespace {
+
+std::uint32_t
+MultiplyCRC32C(std::uint32_t x, std::uint32_t y) noexcept
+{
+    // x * y modulo the CRC32C polynomial, both bit-reflected
+    std::uint32_t z = 0;
+
+    for (std::uint32_t m = UINT32_C(1) << 31; m != 0; m >>= 1) {
+        if ((x & m) != 0) {
+            z ^= y;
+        }
+
+        y = (y >> 1) ^ (UINT32_C(0x82F63B78) & -(y & 1));
+    }
+
+    return z;
+}
+
+
+std::uint32_t
+ShiftCRC32C(std::uint32_t crc, std::size_t numberOfZeroBytes) noexcept
+{
+    // multiply by x^(8 * numberOfZeroBytes), squaring x^8 for each bit of the count
+    std::uint32_t x = UINT32_C(1) << 23;
+
+    for (; numberOfZeroBytes >= 1; numberOfZeroBytes >>= 1) {
+        if ((numberOfZeroBytes & 1) != 0) {
+            crc = MultiplyCRC32C(x, crc);
+        }
+
+        x = MultiplyCRC32C(x, x);
+    }
+
+    return crc;
+}
+
+
+std::uint32_t
+ComputeCRC32CByTable(std::uint32_t crc, const unsigned char *bytes, std::size_t numberOfBytes)
+    noexcept
+{
+    static const struct Table {
+        std::uint32_t entries[256];
+
+        Table() noexcept {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t x = i;
+
+                for (int j = 0; j < 8; ++j) {
+                    x = (x >> 1) ^ (UINT32_C(0x82F63B78) & -(x & 1));
+                }
+
+                entries[i] = x;
+            }
+        }
+    } table;
+
+    for (std::size_t i = 0; i < numberOfBytes; ++i) {
+        crc = (crc >> 8) ^ table.entries[(crc ^ bytes[i]) & 0xFF];
+    }
+
+    return crc;
+}
+
+
+#ifdef __x86_64__
+std::uint32_t
+ComputeCRC32CBySSE42(std::uint32_t crc, const unsigned char *bytes, std::size_t numberOfBytes)
+    noexcept
+{
+    std::uint64_t crc64 = crc;
+
+    for (; numberOfBytes >= 8; numberOfBytes -= 8, bytes += 8) {
+        std::uint64_t x;
+        std::memcpy(&x, bytes, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, x);
+    }
+
+    crc = crc64;
+
+    for (; numberOfBytes >= 1; --numberOfBytes, ++bytes) {
+        crc = __builtin_ia32_crc32qi(crc, *bytes);
+    }
+
+    return crc;
+}
+#endif
+
+} // namespace
+
 } // namespace siren
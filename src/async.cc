@@ -2,7 +2,10 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <new>
 
 #include "assert.h"
 #include "event.h"
@@ -12,15 +15,29 @@
 
 namespace siren {
 
-namespace detail {
+namespace {
 
-struct AsyncTask
-  : ThreadPoolTask
+struct ParallelContext
 {
-    Event *event;
+    detail::AsyncParallelRange *ranges;
+    std::size_t numberOfRanges;
+    std::size_t grainSize;
+    void (*function)(void *, std::size_t, std::size_t, std::size_t);
+    void *argument;
+    std::atomic<bool> isStopped;
 };
 
-} // namespace detail
+
+struct ParallelWorker
+{
+    ParallelContext *context;
+    std::size_t index;
+};
+
+
+void DoParallelWork(void *);
+
+} // namespace
 
 
 void
@@ -40,26 +57,31 @@ Async::EventTrigger(ThreadPool *threadPool, Loop *loop) noexcept
 
         threadPool->removeCompletedTasks([] (ThreadPoolTask *threadPoolTask) -> void {
             auto task = static_cast<Task *>(threadPoolTask);
-            task->event->trigger();
+            task->isCompleted = true;
+            Waiter *waiter = task->waiter;
+
+            if (waiter != nullptr && waiter->taskCount >= 1 && --waiter->taskCount == 0) {
+                waiter->event.trigger();
+            }
         });
     }
 }
 
 
-Async::Async(Loop *loop, std::size_t numberOfThreads)
-  : threadPool_(std::make_unique<ThreadPool>(numberOfThreads)),
-    loop_(loop),
+Async::Async(Loop *loop, std::size_t minNumberOfThreads, std::size_t maxNumberOfThreads)
+  : loop_(loop),
     taskCount_(0)
 {
     SIREN_ASSERT(loop != nullptr);
+    threadPools_[0] = std::make_unique<ThreadPool>(minNumberOfThreads, maxNumberOfThreads);
     initialize();
 }
 
 
 Async::Async(Async &&other) noexcept
-  : threadPool_(std::move(other.threadPool_)),
-    loop_(other.loop_),
-    taskCount_(0)
+  : loop_(other.loop_),
+    taskCount_(0),
+    taskPool_(std::move(other.taskPool_))
 {
     SIREN_ASSERT(other.taskCount_ == 0);
     other.move(this);
@@ -80,8 +102,8 @@ Async::operator=(Async &&other) noexcept
         SIREN_ASSERT(taskCount_ == 0);
         SIREN_ASSERT(other.taskCount_ == 0);
         finalize();
-        threadPool_ = std::move(other.threadPool_);
         loop_ = other.loop_;
+        taskPool_ = std::move(other.taskPool_);
         other.move(this);
     }
 
@@ -92,14 +114,11 @@ Async::operator=(Async &&other) noexcept
 void
 Async::initialize()
 {
-    loop_->manageFD(threadPool_->getEventFD());
-
-    auto scopeGuard = MakeScopeGuard([&] () -> void {
-        loop_->unmanageFD(threadPool_->getEventFD());
-    });
+    for (void *&fiberHandle : fiberHandles_) {
+        fiberHandle = nullptr;
+    }
 
-    fiberHandle_ = loop_->createFiber(std::bind(EventTrigger, threadPool_.get(), loop_), 0, true);
-    scopeGuard.dismiss();
+    startLane(0);
 }
 
 
@@ -107,8 +126,12 @@ void
 Async::finalize() noexcept
 {
     if (isValid()) {
-        loop_->interruptFiber(fiberHandle_);
-        loop_->unmanageFD(threadPool_->getEventFD());
+        for (std::size_t i = 0; i < detail::NumberOfAsyncLanes; ++i) {
+            if (fiberHandles_[i] != nullptr) {
+                loop_->interruptFiber(fiberHandles_[i]);
+                loop_->unmanageFD(threadPools_[i]->getEventFD());
+            }
+        }
     }
 }
 
@@ -116,57 +139,374 @@ Async::finalize() noexcept
 void
 Async::move(Async *other) noexcept
 {
-    other->fiberHandle_ = fiberHandle_;
-    fiberHandle_ = nullptr;
+    for (std::size_t i = 0; i < detail::NumberOfAsyncLanes; ++i) {
+        other->threadPools_[i] = std::move(threadPools_[i]);
+        other->fiberHandles_[i] = fiberHandles_[i];
+        fiberHandles_[i] = nullptr;
+    }
 }
 
 
 void
-Async::executeTask(const std::function<void ()> &procedure)
+Async::startLane(std::size_t laneIndex)
+{
+    ThreadPool *threadPool = threadPools_[laneIndex].get();
+    loop_->manageFD(threadPool->getEventFD());
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        loop_->unmanageFD(threadPool->getEventFD());
+    });
+
+    fiberHandles_[laneIndex] = loop_->createFiber(std::bind(EventTrigger, threadPool, loop_), 0
+                                                  , true);
+    scopeGuard.dismiss();
+}
+
+
+ThreadPool *
+Async::getThreadPool(AsyncLane lane) noexcept
+{
+    std::unique_ptr<ThreadPool> &threadPool = threadPools_[static_cast<std::size_t>(lane)];
+    return threadPool == nullptr ? threadPools_[0].get() : threadPool.get();
+}
+
+
+void
+Async::addLane(AsyncLane lane, std::size_t minNumberOfThreads, std::size_t maxNumberOfThreads)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(lane != AsyncLane::Default);
+    auto laneIndex = static_cast<std::size_t>(lane);
+    SIREN_ASSERT(threadPools_[laneIndex] == nullptr);
+    threadPools_[laneIndex] = std::make_unique<ThreadPool>(minNumberOfThreads
+                                                           , maxNumberOfThreads);
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        threadPools_[laneIndex].reset();
+    });
+
+    cpu_set_t cpuSet;
+    threadPools_[0]->getCPUAffinity(&cpuSet);
+    threadPools_[laneIndex]->setCPUAffinity(cpuSet);
+    startLane(laneIndex);
+    scopeGuard.dismiss();
+}
+
+
+void
+Async::setCPUAffinity(const cpu_set_t &cpuSet)
 {
     SIREN_ASSERT(isValid());
+
+    for (std::unique_ptr<ThreadPool> &threadPool : threadPools_) {
+        if (threadPool != nullptr) {
+            threadPool->setCPUAffinity(cpuSet);
+        }
+    }
+}
+
+
+void
+Async::executeTask(const std::function<void ()> &procedure)
+{
     SIREN_ASSERT(procedure != nullptr);
-    Task task;
-    threadPool_->addTask(&task, procedure);
-    waitForTask(&task);
-    task.check();
+
+    executeTask(AsyncLane::Default, [] (void *argument) -> void {
+        (*static_cast<const std::function<void ()> *>(argument))();
+    }, const_cast<std::function<void ()> *>(&procedure));
 }
 
 
 void
 Async::executeTask(std::function<void ()> &&procedure)
+{
+    executeTask(static_cast<const std::function<void ()> &>(procedure));
+}
+
+
+void
+Async::executeTask(AsyncLane lane, void (*function)(void *), void *argument)
 {
     SIREN_ASSERT(isValid());
-    SIREN_ASSERT(procedure != nullptr);
     Task task;
-    threadPool_->addTask(&task, std::move(procedure));
+    (task.threadPool = getThreadPool(lane))->addTask(&task, function, argument);
     waitForTask(&task);
     task.check();
 }
 
 
+std::size_t
+Async::getParallelism(AsyncLane lane, std::size_t firstIndex, std::size_t lastIndex
+                      , std::size_t grainSize) const noexcept
+{
+    if (firstIndex >= lastIndex) {
+        return 0;
+    }
+
+    std::size_t numberOfChunks = (lastIndex - firstIndex - 1) / grainSize + 1;
+    return std::max<std::size_t>(std::min(numberOfChunks
+                                          , getThreadPool(lane)->getNumberOfThreads()), 1);
+}
+
+
+void
+Async::executeParallelTasks(AsyncLane lane, std::size_t firstIndex, std::size_t lastIndex
+                            , std::size_t grainSize, std::size_t parallelism
+                            , void (*function)(void *, std::size_t, std::size_t, std::size_t)
+                            , void *argument)
+{
+    if (parallelism == 0) {
+        return;
+    }
+
+    // the chunks are split into one contiguous range per worker, a worker which runs out of
+    // its own chunks steals from the others' ranges
+    std::size_t numberOfChunks = (lastIndex - firstIndex - 1) / grainSize + 1;
+    std::unique_ptr<ParallelRange []> ranges = std::make_unique<ParallelRange []>(parallelism);
+
+    for (std::size_t i = 0; i < parallelism; ++i) {
+        ranges[i].nextIndex.store(firstIndex + numberOfChunks * i / parallelism * grainSize
+                                  , std::memory_order_relaxed);
+        ranges[i].lastIndex = std::min(firstIndex + numberOfChunks * (i + 1) / parallelism
+                                       * grainSize, lastIndex);
+        ranges[i].task = nullptr;
+    }
+
+    ParallelContext context = {ranges.get(), parallelism, grainSize, function, argument, {false}};
+    ThreadPool *threadPool = getThreadPool(lane);
+    Waiter waiter = {loop_->makeEvent(), 0};
+    std::size_t numberOfTasks = 0;
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        context.isStopped.store(true, std::memory_order_relaxed);
+        cancelParallelTasks(ranges.get(), numberOfTasks, &waiter);
+    });
+
+    while (numberOfTasks < parallelism) {
+        Task *task = ranges[numberOfTasks].task = createTask();
+        ++numberOfTasks;
+        new (task->procedure) ParallelWorker{&context, numberOfTasks - 1};
+        task->threadPool = threadPool;
+        threadPool->addTask(task, DoParallelWork, task);
+        task->waiter = &waiter;
+        ++waiter.taskCount;
+    }
+
+    waiter.event.waitFor();
+    scopeGuard.dismiss();
+    std::exception_ptr exception;
+
+    for (std::size_t i = 0; i < numberOfTasks; ++i) {
+        Task *task = ranges[i].task;
+
+        try {
+            task->check();
+        } catch (...) {
+            if (exception == nullptr) {
+                exception = std::current_exception();
+            }
+        }
+
+        destroyTask(task);
+    }
+
+    if (exception != nullptr) {
+        std::rethrow_exception(exception);
+    }
+}
+
+
+void
+Async::cancelParallelTasks(ParallelRange *ranges, std::size_t numberOfTasks, Waiter *waiter)
+    noexcept
+{
+    for (std::size_t i = 0; i < numberOfTasks; ++i) {
+        Task *task = ranges[i].task;
+
+        if (task->waiter != nullptr && !task->isCompleted && task->threadPool->removeTask(task)) {
+            task->waiter = nullptr;
+            --waiter->taskCount;
+        }
+    }
+
+    bool fiberIsInterrupted = false;
+
+    // the running tasks refer to this fiber's stack
+    while (waiter->taskCount >= 1) {
+        try {
+            waiter->event.waitFor();
+        } catch (FiberInterruption) {
+            fiberIsInterrupted = true;
+        }
+    }
+
+    for (std::size_t i = 0; i < numberOfTasks; ++i) {
+        Task *task = ranges[i].task;
+
+        if (task->isCompleted) {
+            try {
+                task->check();
+            } catch (...) {
+            }
+        }
+
+        destroyTask(task);
+    }
+
+    if (fiberIsInterrupted) {
+        loop_->interruptFiber(loop_->getCurrentFiber());
+    }
+}
+
+
 void
 Async::waitForTask(Task *task)
 {
-    Event event = loop_->makeEvent();
+    Waiter waiter = {loop_->makeEvent(), 1};
+    task->waiter = &waiter;
     ++taskCount_;
 
     auto scopeGuard = MakeScopeGuard([&] () -> void {
+        task->waiter = nullptr;
         --taskCount_;
     });
 
     try {
-        (task->event = &event)->waitFor();
+        waiter.event.waitFor();
     } catch (FiberInterruption) {
-        bool taskIsCompleted;
-        threadPool_->removeTask(task, &taskIsCompleted);
-
-        if (!taskIsCompleted) {
+        if (task->threadPool->removeTask(task)) {
             throw;
         }
 
+        // the task is running, so its procedure may still refer to this fiber's stack:
+        // keep the fiber parked (not the loop) until the task completes
+        waitForCompletedTask(task);
+        loop_->interruptFiber(loop_->getCurrentFiber());
+    }
+}
+
+
+detail::AsyncTask *
+Async::createTask()
+{
+    Task *task = taskPool_.createObject();
+    ++taskCount_;
+    return task;
+}
+
+
+void
+Async::destroyTask(Task *task) noexcept
+{
+    if (task->procedureDestructor != nullptr) {
+        task->procedureDestructor(task->procedure);
+    }
+
+    taskPool_.destroyObject(task);
+    --taskCount_;
+}
+
+
+void
+Async::joinTask(Task *task)
+{
+    if (task->isCompleted) {
+        return;
+    }
+
+    Waiter waiter = {loop_->makeEvent(), 1};
+    task->waiter = &waiter;
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        task->waiter = nullptr;
+    });
+
+    waiter.event.waitFor();
+}
+
+
+bool
+Async::cancelTask(Task *task) noexcept
+{
+    if (task->isCompleted) {
+        return false;
+    }
+
+    if (task->threadPool->removeTask(task)) {
+        return true;
+    }
+
+    if (waitForCompletedTask(task)) {
         loop_->interruptFiber(loop_->getCurrentFiber());
     }
+
+    return false;
 }
 
+
+bool
+Async::waitForCompletedTask(Task *task) noexcept
+{
+    if (task->isCompleted) {
+        return false;
+    }
+
+    Waiter waiter = {loop_->makeEvent(), 1};
+    task->waiter = &waiter;
+    bool fiberIsInterrupted = false;
+
+    for (;;) {
+        try {
+            waiter.event.waitFor();
+            break;
+        } catch (FiberInterruption) {
+            fiberIsInterrupted = true;
+        }
+    }
+
+    task->waiter = nullptr;
+    return fiberIsInterrupted;
+}
+
+
+namespace {
+
+void
+DoParallelWork(void *argument)
+{
+    auto task = static_cast<detail::AsyncTask *>(argument);
+    auto worker = reinterpret_cast<ParallelWorker *>(task->procedure);
+    ParallelContext *context = worker->context;
+
+    for (std::size_t i = 0; i < context->numberOfRanges; ++i) {
+        detail::AsyncParallelRange *range = &context->ranges[(worker->index + i)
+                                                             % context->numberOfRanges];
+
+        for (;;) {
+            if (context->isStopped.load(std::memory_order_relaxed)
+                || ThreadPool::CurrentTaskIsCancelled()) {
+                return;
+            }
+
+            std::size_t firstIndex = range->nextIndex.fetch_add(context->grainSize
+                                                                , std::memory_order_relaxed);
+
+            if (firstIndex >= range->lastIndex) {
+                break;
+            }
+
+            std::size_t lastIndex = std::min(firstIndex + context->grainSize, range->lastIndex);
+
+            try {
+                context->function(context->argument, worker->index, firstIndex, lastIndex);
+            } catch (...) {
+                context->isStopped.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    }
+}
+
+} // namespace
+
 } // namespace siren
@@ -0,0 +1,122 @@
+#include "buffer.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+
+
+namespace siren {
+
+namespace {
+
+const int MinBlockSizeShift = 6;
+const int MaxBlockSizeShift = 18;
+const std::size_t MaxCachedSizePerClass = std::size_t(1) << MaxBlockSizeShift;
+
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+
+struct BlockCache
+{
+    FreeBlock *freeBlocks[MaxBlockSizeShift - MinBlockSizeShift + 1] = {};
+    std::size_t cachedSizes[MaxBlockSizeShift - MinBlockSizeShift + 1] = {};
+
+    ~BlockCache();
+};
+
+
+thread_local BlockCache ThreadBlockCache;
+
+int GetSizeShift(std::size_t) noexcept;
+
+} // namespace
+
+
+namespace detail {
+
+void *
+AllocatePooledBlock(std::size_t blockSize)
+{
+    int sizeShift = GetSizeShift(blockSize);
+
+    if (sizeShift <= MaxBlockSizeShift) {
+        int i = sizeShift - MinBlockSizeShift;
+        FreeBlock *freeBlock = ThreadBlockCache.freeBlocks[i];
+
+        if (freeBlock != nullptr) {
+            ThreadBlockCache.freeBlocks[i] = freeBlock->next;
+            ThreadBlockCache.cachedSizes[i] -= std::size_t(1) << sizeShift;
+            return freeBlock;
+        }
+    }
+
+    void *block = std::malloc(std::size_t(1) << sizeShift);
+
+    if (block == nullptr) {
+        throw std::system_error(errno, std::system_category(), "malloc() failed");
+    }
+
+    return block;
+}
+
+
+void
+FreePooledBlock(void *block, std::size_t blockSize) noexcept
+{
+    int sizeShift = GetSizeShift(blockSize);
+
+    if (sizeShift <= MaxBlockSizeShift) {
+        int i = sizeShift - MinBlockSizeShift;
+
+        // bound what a thread keeps, the rest goes back to the heap
+        if (ThreadBlockCache.cachedSizes[i] + (std::size_t(1) << sizeShift)
+            <= MaxCachedSizePerClass) {
+            auto freeBlock = static_cast<FreeBlock *>(block);
+            freeBlock->next = ThreadBlockCache.freeBlocks[i];
+            ThreadBlockCache.freeBlocks[i] = freeBlock;
+            ThreadBlockCache.cachedSizes[i] += std::size_t(1) << sizeShift;
+            return;
+        }
+    }
+
+    std::free(block);
+}
+
+} // namespace detail
+
+
+namespace {
+
+BlockCache::~BlockCache()
+{
+    for (std::size_t i = 0; i < sizeof(freeBlocks) / sizeof(*freeBlocks); ++i) {
+        for (FreeBlock *freeBlock = freeBlocks[i]; freeBlock != nullptr;) {
+            FreeBlock *nextFreeBlock = freeBlock->next;
+            std::free(freeBlock);
+            freeBlock = nextFreeBlock;
+        }
+
+        // blocks freed by later thread-local destructors go straight back to the heap
+        freeBlocks[i] = nullptr;
+        cachedSizes[i] = MaxCachedSizePerClass;
+    }
+}
+
+
+int
+GetSizeShift(std::size_t blockSize) noexcept
+{
+    if (blockSize <= std::size_t(1) << MinBlockSizeShift) {
+        return MinBlockSizeShift;
+    }
+
+    return __builtin_ctzl(NextPowerOfTwo(blockSize));
+}
+
+} // namespace
+
+} // namespace siren
@@ -1,5 +1,9 @@
 #include <errno.h>
 #include <stdarg.h>
+#include <stdlib.h>
+
+#include <new>
+#include <system_error>
 
 #include <fcntl.h>
 #include <netdb.h>
@@ -8,11 +12,20 @@
 #include <unistd.h>
 
 #include "async.h"
+#include "dns_resolver.h"
 #include "loop.h"
 
 
 siren::Loop *siren_loop = nullptr;
 siren::Async *siren_async = nullptr;
+siren::DNSResolver *siren_dns_resolver = nullptr;
+
+
+namespace {
+
+int ResolveAddrInfo(const char *, const char *, const struct addrinfo *, struct addrinfo **);
+
+} // namespace
 
 
 extern "C" {
@@ -37,7 +50,7 @@ siren_fs_open(const char *arg1, int arg2, ...) noexcept
     va_end(ap);
 
     try {
-        return siren_async->callFunction(open, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, open, arg1, arg2, arg3);
     } catch (siren::FiberInterruption){
         errno = ECANCELED;
         return -1;
@@ -86,7 +99,7 @@ ssize_t
 siren_fs_read(int arg1, void *arg2, size_t arg3) noexcept
 {
     try {
-        return siren_async->callFunction(read, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, read, arg1, arg2, arg3);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -110,7 +123,7 @@ ssize_t
 siren_fs_write(int arg1, const void *arg2, size_t arg3) noexcept
 {
     try {
-        return siren_async->callFunction(write, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, write, arg1, arg2, arg3);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -134,7 +147,7 @@ ssize_t
 siren_fs_readv(int arg1, const struct iovec *arg2, int arg3) noexcept
 {
     try {
-        return siren_async->callFunction(readv, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, readv, arg1, arg2, arg3);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -158,7 +171,7 @@ ssize_t
 siren_fs_writev(int arg1, const struct iovec *arg2, int arg3) noexcept
 {
     try {
-        return siren_async->callFunction(writev, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, writev, arg1, arg2, arg3);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -170,7 +183,7 @@ off_t
 siren_lseek(int arg1, off_t arg2, int arg3) noexcept
 {
     try {
-        return siren_async->callFunction(lseek, arg1, arg2, arg3);
+        return siren_async->callFunction(siren::AsyncLane::Disk, lseek, arg1, arg2, arg3);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -189,7 +202,7 @@ int
 siren_fs_close(int arg1) noexcept
 {
     try {
-        return siren_async->callFunction(close, arg1);
+        return siren_async->callFunction(siren::AsyncLane::Disk, close, arg1);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return -1;
@@ -321,7 +334,16 @@ siren_getaddrinfo(const char *arg1, const char *arg2, const struct addrinfo *arg
                   , struct addrinfo **arg4) noexcept
 {
     try {
-        return siren_async->callFunction(getaddrinfo, arg1, arg2, arg3, arg4);
+        if (siren_dns_resolver != nullptr) {
+            int errorCode = ResolveAddrInfo(arg1, arg2, arg3, arg4);
+
+            if (errorCode != EAI_BADFLAGS) {
+                return errorCode;
+            }
+        }
+
+        return siren_async->callFunction(siren::AsyncLane::DNS, getaddrinfo, arg1, arg2, arg3
+                                         , arg4);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return EAI_SYSTEM;
@@ -334,7 +356,8 @@ siren_getnameinfo(const struct sockaddr *arg1, socklen_t arg2, char *arg3, sockl
                   , char *arg5, socklen_t arg6, int arg7) noexcept
 {
     try {
-        return siren_async->callFunction(getnameinfo, arg1, arg2, arg3, arg4, arg5, arg6, arg7);
+        return siren_async->callFunction(siren::AsyncLane::DNS, getnameinfo, arg1, arg2, arg3
+                                         , arg4, arg5, arg6, arg7);
     } catch (siren::FiberInterruption) {
         errno = ECANCELED;
         return EAI_SYSTEM;
@@ -419,3 +442,84 @@ maybe_siren_close(int arg1) noexcept
 }
 
 } // extern "C"
+
+
+namespace {
+
+int
+ResolveAddrInfo(const char *hostName, const char *serviceName, const struct addrinfo *hints
+                , struct addrinfo **result)
+{
+    // only explicit IPv4 lookups go through the cache, which keeps a single A record per name,
+    // anything else (AF_UNSPEC included) falls back to getaddrinfo() with EAI_BADFLAGS
+    if (hostName == nullptr || hints == nullptr || hints->ai_family != AF_INET
+        || (hints->ai_flags & ~(AI_ADDRCONFIG | AI_NUMERICSERV)) != 0
+        || hints->ai_protocol != 0) {
+        return EAI_BADFLAGS;
+    }
+
+    unsigned long portNumber = 0;
+
+    if (serviceName != nullptr) {
+        char *end;
+        portNumber = strtoul(serviceName, &end, 10);
+
+        if (*serviceName == '\0' || *end != '\0' || portNumber > 65535) {
+            return EAI_BADFLAGS;
+        }
+    }
+
+    uint32_t address;
+
+    try {
+        address = siren_dns_resolver->resolveName(hostName);
+    } catch (const siren::GAIError &gaiError) {
+        return gaiError.getCode();
+    } catch (const std::system_error &systemError) {
+        errno = systemError.code().value();
+        return EAI_SYSTEM;
+    } catch (const std::bad_alloc &) {
+        return EAI_MEMORY;
+    }
+
+    static const int socketTypes[] = {SOCK_STREAM, SOCK_DGRAM};
+    int hintedSocketType = hints->ai_socktype;
+    struct addrinfo *head = nullptr;
+    struct addrinfo **tail = &head;
+
+    for (int socketType : socketTypes) {
+        if (hintedSocketType != 0 && hintedSocketType != socketType) {
+            continue;
+        }
+
+        // a single block per node, the layout freeaddrinfo() of glibc expects
+        auto node = static_cast<struct addrinfo *>(calloc(1, sizeof(struct addrinfo)
+                                                             + sizeof(struct sockaddr_in)));
+
+        if (node == nullptr) {
+            freeaddrinfo(head);
+            return EAI_MEMORY;
+        }
+
+        auto name = reinterpret_cast<struct sockaddr_in *>(node + 1);
+        name->sin_family = AF_INET;
+        name->sin_addr.s_addr = htonl(address);
+        name->sin_port = htons(portNumber);
+        node->ai_family = AF_INET;
+        node->ai_socktype = socketType;
+        node->ai_protocol = socketType == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP;
+        node->ai_addrlen = sizeof(*name);
+        node->ai_addr = reinterpret_cast<struct sockaddr *>(name);
+        *tail = node;
+        tail = &node->ai_next;
+    }
+
+    if (head == nullptr) {
+        return EAI_SOCKTYPE;
+    }
+
+    *result = head;
+    return 0;
+}
+
+} // namespace
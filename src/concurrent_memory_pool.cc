@@ -0,0 +1,408 @@
+#include "concurrent_memory_pool.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "assert.h"
+#include "scope_guard.h"
+#include "utility.h"
+
+
+namespace siren {
+
+namespace detail {
+
+struct ConcurrentMemoryPoolCache
+{
+    void *lastFreeBlock = nullptr;
+    std::size_t freeBlockCount = 0;
+    std::atomic<void *> lastRemoteFreeBlock{nullptr};
+    char *firstNewBlock = nullptr;
+    char *chunkEnd = nullptr;
+};
+
+
+struct ConcurrentMemoryPoolCore
+{
+    const std::uint64_t id;
+    const std::size_t blockSize;
+    const std::size_t chunkHeaderSize;
+    const std::size_t chunkSize;
+    const std::size_t batchLength;
+    std::mutex mutex;
+    void *lastFreeBatch = nullptr;
+    std::vector<void *> chunks;
+    std::vector<ConcurrentMemoryPoolCache *> caches;
+    std::vector<ConcurrentMemoryPoolCache *> orphanCaches;
+
+    explicit ConcurrentMemoryPoolCore(std::size_t, std::size_t, std::size_t) noexcept;
+    ~ConcurrentMemoryPoolCore();
+};
+
+} // namespace detail
+
+
+namespace {
+
+typedef detail::ConcurrentMemoryPoolCache Cache;
+typedef detail::ConcurrentMemoryPoolCore Core;
+
+
+// every chunk is aligned to its size and starts with the cache owning its blocks
+struct Chunk
+{
+    Cache *cache;
+};
+
+
+struct ThreadCache
+{
+    std::uint64_t poolID;
+    std::weak_ptr<Core> core;
+    Cache *cache;
+};
+
+
+struct ThreadCacheRegistry
+{
+    std::vector<ThreadCache> threadCaches;
+
+    ~ThreadCacheRegistry();
+};
+
+
+const std::size_t BatchSize = 8 * 1024;
+const std::size_t MinBatchLength = 8;
+
+std::atomic<std::uint64_t> PoolIDCount(0);
+thread_local ThreadCacheRegistry ThreadCaches;
+thread_local std::uint64_t LastPoolID = 0;
+thread_local Cache *LastCache = nullptr;
+
+void *GetBlockNext(void *) noexcept;
+void SetBlockNext(void *, void *) noexcept;
+void *GetBatchNext(void *) noexcept;
+void SetBatchNext(void *, void *) noexcept;
+std::size_t CountBlocks(void *) noexcept;
+void PushBatch(Core *, void *) noexcept;
+
+} // namespace
+
+
+ConcurrentMemoryPool::ConcurrentMemoryPool(std::size_t blockAlignment, std::size_t blockSize
+                                           , std::size_t chunkLength)
+  : core_(std::make_shared<Core>(blockAlignment, blockSize, chunkLength))
+{
+}
+
+
+void *
+ConcurrentMemoryPool::allocateBlock()
+{
+    Cache *cache = getCache();
+
+    if (cache->lastFreeBlock == nullptr && !refillCache(cache)) {
+        return makeBlock(cache);
+    }
+
+    void *block = cache->lastFreeBlock;
+    cache->lastFreeBlock = GetBlockNext(block);
+    --cache->freeBlockCount;
+    return block;
+}
+
+
+void
+ConcurrentMemoryPool::freeBlock(void *block) noexcept
+{
+    SIREN_ASSERT(block != nullptr);
+    auto chunk = reinterpret_cast<Chunk *>(reinterpret_cast<std::uintptr_t>(block)
+                                           & ~(core_->chunkSize - 1));
+    Cache *cache = chunk->cache;
+
+    if (cache == findCache()) {
+        SetBlockNext(block, cache->lastFreeBlock);
+        cache->lastFreeBlock = block;
+
+        // bound what a thread keeps, a batch goes to the depot for the other threads
+        if (++cache->freeBlockCount > 2 * core_->batchLength) {
+            spillCache(cache);
+        }
+    } else {
+        void *lastRemoteFreeBlock = cache->lastRemoteFreeBlock.load(std::memory_order_relaxed);
+
+        do {
+            SetBlockNext(block, lastRemoteFreeBlock);
+        } while (!cache->lastRemoteFreeBlock.compare_exchange_weak(lastRemoteFreeBlock, block
+                                                                   , std::memory_order_release
+                                                                   , std::memory_order_relaxed));
+    }
+}
+
+
+ConcurrentMemoryPool::Cache *
+ConcurrentMemoryPool::findCache() const noexcept
+{
+    if (LastPoolID == core_->id) {
+        return LastCache;
+    }
+
+    for (const ThreadCache &threadCache : ThreadCaches.threadCaches) {
+        if (threadCache.poolID == core_->id) {
+            LastPoolID = threadCache.poolID;
+            LastCache = threadCache.cache;
+            return threadCache.cache;
+        }
+    }
+
+    return nullptr;
+}
+
+
+bool
+ConcurrentMemoryPool::refillCache(Cache *cache) noexcept
+{
+    // take back, in one go, every block other threads have freed since the last time
+    void *lastFreeBlock = cache->lastRemoteFreeBlock.exchange(nullptr, std::memory_order_acquire);
+
+    if (lastFreeBlock == nullptr) {
+        std::lock_guard<std::mutex> lockGuard(core_->mutex);
+        lastFreeBlock = core_->lastFreeBatch;
+
+        if (lastFreeBlock != nullptr) {
+            core_->lastFreeBatch = GetBatchNext(lastFreeBlock);
+        } else {
+            // blocks freed to the caches of exited threads would be stuck until adoption
+            for (Cache *orphanCache : core_->orphanCaches) {
+                lastFreeBlock = orphanCache->lastRemoteFreeBlock.exchange(
+                    nullptr, std::memory_order_acquire);
+
+                if (lastFreeBlock != nullptr) {
+                    break;
+                }
+            }
+
+            if (lastFreeBlock == nullptr) {
+                return false;
+            }
+        }
+    }
+
+    cache->lastFreeBlock = lastFreeBlock;
+    cache->freeBlockCount = CountBlocks(lastFreeBlock);
+    return true;
+}
+
+
+void
+ConcurrentMemoryPool::spillCache(Cache *cache) noexcept
+{
+    void *lastFreeBatch = cache->lastFreeBlock;
+    void *block = lastFreeBatch;
+
+    for (std::size_t i = 1; i < core_->batchLength; ++i) {
+        block = GetBlockNext(block);
+    }
+
+    cache->lastFreeBlock = GetBlockNext(block);
+    cache->freeBlockCount -= core_->batchLength;
+    SetBlockNext(block, nullptr);
+    std::lock_guard<std::mutex> lockGuard(core_->mutex);
+    PushBatch(core_.get(), lastFreeBatch);
+}
+
+
+ConcurrentMemoryPool::Cache *
+ConcurrentMemoryPool::getCache()
+{
+    Cache *cache = findCache();
+
+    if (cache != nullptr) {
+        return cache;
+    }
+
+    std::vector<ThreadCache> &threadCaches = ThreadCaches.threadCaches;
+
+    threadCaches.erase(std::remove_if(threadCaches.begin(), threadCaches.end()
+                                      , [] (const ThreadCache &threadCache) -> bool {
+        return threadCache.core.expired();
+    }), threadCaches.end());
+
+    threadCaches.reserve(threadCaches.size() + 1);
+
+    {
+        std::lock_guard<std::mutex> lockGuard(core_->mutex);
+
+        // adopt a cache left by an exited thread before making a new one
+        if (core_->orphanCaches.empty()) {
+            core_->caches.reserve(core_->caches.size() + 1);
+            // every cache may become an orphan on thread exit, where allocating is not an option
+            core_->orphanCaches.reserve(core_->caches.size() + 1);
+            cache = new Cache();
+            core_->caches.push_back(cache);
+        } else {
+            cache = core_->orphanCaches.back();
+            core_->orphanCaches.pop_back();
+        }
+    }
+
+    threadCaches.push_back({core_->id, core_, cache});
+    LastPoolID = core_->id;
+    LastCache = cache;
+    return cache;
+}
+
+
+void *
+ConcurrentMemoryPool::makeBlock(Cache *cache)
+{
+    if (static_cast<std::size_t>(cache->chunkEnd - cache->firstNewBlock) < core_->blockSize) {
+        void *chunk;
+        int errorNumber = posix_memalign(&chunk, core_->chunkSize, core_->chunkSize);
+
+        if (errorNumber != 0) {
+            throw std::system_error(errorNumber, std::system_category()
+                                    , "posix_memalign() failed");
+        }
+
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            std::free(chunk);
+        });
+
+        {
+            std::lock_guard<std::mutex> lockGuard(core_->mutex);
+            core_->chunks.push_back(chunk);
+        }
+
+        scopeGuard.dismiss();
+        static_cast<Chunk *>(chunk)->cache = cache;
+        cache->firstNewBlock = static_cast<char *>(chunk) + core_->chunkHeaderSize;
+        cache->chunkEnd = static_cast<char *>(chunk) + core_->chunkSize;
+    }
+
+    void *block = cache->firstNewBlock;
+    cache->firstNewBlock += core_->blockSize;
+    return block;
+}
+
+
+namespace detail {
+
+ConcurrentMemoryPoolCore::ConcurrentMemoryPoolCore(std::size_t blockAlignment
+                                                   , std::size_t blockSize
+                                                   , std::size_t chunkLength) noexcept
+  : id(++PoolIDCount),
+    blockSize(AlignSize(std::max(blockSize, 2 * sizeof(void *))
+                        , std::max(NextPowerOfTwo(blockAlignment), std::size_t(1)))),
+    chunkHeaderSize(AlignSize(sizeof(Chunk), std::max(NextPowerOfTwo(blockAlignment)
+                                                      , std::size_t(1)))),
+    chunkSize(std::max(NextPowerOfTwo(chunkHeaderSize + std::max(chunkLength, std::size_t(64))
+                                      * this->blockSize), std::size_t(4096))),
+    batchLength(std::max(BatchSize / this->blockSize, MinBatchLength))
+{
+    SIREN_ASSERT(blockAlignment <= alignof(std::max_align_t));
+}
+
+
+ConcurrentMemoryPoolCore::~ConcurrentMemoryPoolCore()
+{
+    for (void *chunk : chunks) {
+        std::free(chunk);
+    }
+
+    for (ConcurrentMemoryPoolCache *cache : caches) {
+        delete cache;
+    }
+}
+
+} // namespace detail
+
+
+namespace {
+
+ThreadCacheRegistry::~ThreadCacheRegistry()
+{
+    for (const ThreadCache &threadCache : threadCaches) {
+        std::shared_ptr<Core> core = threadCache.core.lock();
+
+        if (core != nullptr) {
+            // free blocks go to the depot, the cache itself waits for a thread to adopt it
+            std::lock_guard<std::mutex> lockGuard(core->mutex);
+            Cache *cache = threadCache.cache;
+
+            if (cache->lastFreeBlock != nullptr) {
+                PushBatch(core.get(), cache->lastFreeBlock);
+                cache->lastFreeBlock = nullptr;
+                cache->freeBlockCount = 0;
+            }
+
+            core->orphanCaches.push_back(cache);
+        }
+    }
+
+    LastPoolID = 0;
+}
+
+
+void *
+GetBlockNext(void *block) noexcept
+{
+    void *blockNext;
+    std::memcpy(&blockNext, block, sizeof(blockNext));
+    return blockNext;
+}
+
+
+void
+SetBlockNext(void *block, void *blockNext) noexcept
+{
+    std::memcpy(block, &blockNext, sizeof(blockNext));
+}
+
+
+// the first block of a batch links the next batch after its own link
+void *
+GetBatchNext(void *batch) noexcept
+{
+    void *batchNext;
+    std::memcpy(&batchNext, static_cast<char *>(batch) + sizeof(void *), sizeof(batchNext));
+    return batchNext;
+}
+
+
+void
+SetBatchNext(void *batch, void *batchNext) noexcept
+{
+    std::memcpy(static_cast<char *>(batch) + sizeof(void *), &batchNext, sizeof(batchNext));
+}
+
+
+std::size_t
+CountBlocks(void *block) noexcept
+{
+    std::size_t blockCount = 0;
+
+    for (; block != nullptr; block = GetBlockNext(block)) {
+        ++blockCount;
+    }
+
+    return blockCount;
+}
+
+
+void
+PushBatch(Core *core, void *batch) noexcept
+{
+    SetBatchNext(batch, core->lastFreeBatch);
+    core->lastFreeBatch = batch;
+}
+
+} // namespace
+
+} // namespace siren
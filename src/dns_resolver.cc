@@ -0,0 +1,616 @@
+#include "dns_resolver.h"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+#include "assert.h"
+#include "async.h"
+#include "loop.h"
+#include "scope_guard.h"
+
+
+namespace siren {
+
+namespace {
+
+const std::size_t MaxMessageSize = 512;
+
+bool LookUpHostsFile(const char *, std::uint32_t *);
+std::size_t EncodeQuery(const char *, std::uint16_t, unsigned char *) noexcept;
+bool DecodeReply(const unsigned char *, std::size_t, std::uint16_t, int *, std::uint32_t *
+                 , std::uint32_t *) noexcept;
+int DecodeAnswers(const unsigned char *, std::size_t, std::uint32_t *, std::uint32_t *) noexcept;
+const unsigned char *SkipName(const unsigned char *, const unsigned char *) noexcept;
+std::uint16_t Load16(const unsigned char *) noexcept;
+std::uint32_t Load32(const unsigned char *) noexcept;
+
+} // namespace
+
+
+DNSResolver::DNSResolver(Loop *loop, Async *async, long defaultTTL, long negativeTTL
+                         , std::size_t maxNumberOfCachedNames)
+  : loop_(loop),
+    async_(async),
+    defaultTTL_(defaultTTL),
+    negativeTTL_(negativeTTL),
+    maxNumberOfCachedNames_(maxNumberOfCachedNames),
+    queryTimeout_(0),
+    maxNumberOfQueries_(0)
+{
+    SIREN_ASSERT(loop != nullptr);
+    initialize();
+}
+
+
+DNSResolver::~DNSResolver()
+{
+    finalize();
+}
+
+
+void
+DNSResolver::initialize()
+{
+    std::random_device randomDevice;
+    randomEngine_.seed(randomDevice());
+    entryCount_ = 0;
+}
+
+
+void
+DNSResolver::finalize() noexcept
+{
+    List entryList;
+
+    // removing nodes while traversing the hash table would skip some of them
+    entryHashTable_.traverse([&] (HashTableNode *hashTableNode) -> void {
+        auto entry = static_cast<CacheEntry *>(hashTableNode);
+        SIREN_ASSERT(entry->referenceCount == 0);
+        entryList.appendNode(entry);
+    });
+
+    uncacheEntries(&entryList);
+}
+
+
+void
+DNSResolver::setNameServer(const IPEndpoint &nameServer, long queryTimeout
+                           , int maxNumberOfQueries)
+{
+    SIREN_ASSERT(queryTimeout >= 1);
+    SIREN_ASSERT(maxNumberOfQueries >= 1);
+    nameServer_ = nameServer;
+    queryTimeout_ = queryTimeout;
+    maxNumberOfQueries_ = maxNumberOfQueries;
+}
+
+
+std::uint32_t
+DNSResolver::resolveName(const char *hostName)
+{
+    SIREN_ASSERT(hostName != nullptr);
+    in_addr address;
+
+    if (inet_pton(AF_INET, hostName, &address) == 1) {
+        return ntohl(address.s_addr);
+    }
+
+    std::size_t hostNameLength = std::strlen(hostName);
+    std::size_t hostNameHash = HashHostName(hostName, hostNameLength);
+    CacheEntry *entry = findEntry(hostName, hostNameLength, hostNameHash);
+
+    if (entry != nullptr && entry->isResolved
+        && entry->expiryTime <= std::chrono::steady_clock::now()) {
+        uncacheEntry(entry);
+        entry = nullptr;
+    }
+
+    if (entry == nullptr) {
+        entry = createEntry(hostName, hostNameLength, hostNameHash);
+        ++entry->referenceCount;
+
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            if (!entry->isResolved) {
+                // let the waiters retry
+                uncacheEntry(entry);
+                entry->event.trigger();
+            }
+
+            releaseEntry(entry);
+        });
+
+        resolveEntry(entry);
+        entry->isResolved = true;
+        entry->event.trigger();
+    } else if (!entry->isResolved) {
+        // coalesce with the lookup in flight
+        ++entry->referenceCount;
+
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            releaseEntry(entry);
+        });
+
+        entry->event.waitFor();
+
+        if (!entry->isResolved) {
+            scopeGuard.dismiss();
+            releaseEntry(entry);
+            return resolveName(hostName);
+        }
+
+        if (entry->errorCode != 0) {
+            throw GAIError(entry->errorCode);
+        }
+
+        return entry->address;
+    }
+
+    // the entry is still cached here
+    if (entry->errorCode != 0) {
+        throw GAIError(entry->errorCode);
+    }
+
+    return entry->address;
+}
+
+
+std::size_t
+DNSResolver::HashHostName(const char *hostName, std::size_t hostNameLength) noexcept
+{
+    // FNV-1a
+    std::size_t hostNameHash = 2166136261U;
+
+    for (std::size_t i = 0; i < hostNameLength; ++i) {
+        hostNameHash = (hostNameHash ^ static_cast<unsigned char>(hostName[i])) * 16777619U;
+    }
+
+    return hostNameHash;
+}
+
+
+detail::DNSCacheEntry *
+DNSResolver::findEntry(const char *hostName, std::size_t hostNameLength
+                       , std::size_t hostNameHash) noexcept
+{
+    HashTableNode *hashTableNode = entryHashTable_.search(
+        hostNameHash,
+
+        [&] (const HashTableNode *hashTableNode) -> bool {
+            auto entry = static_cast<const CacheEntry *>(hashTableNode);
+            return entry->hostName.size() == hostNameLength
+                   && std::memcmp(entry->hostName.data(), hostName, hostNameLength) == 0;
+        }
+    );
+
+    return static_cast<CacheEntry *>(hashTableNode);
+}
+
+
+detail::DNSCacheEntry *
+DNSResolver::createEntry(const char *hostName, std::size_t hostNameLength
+                         , std::size_t hostNameHash)
+{
+    if (entryCount_ >= maxNumberOfCachedNames_) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        removeExpiredEntries(now, false);
+
+        if (entryCount_ >= maxNumberOfCachedNames_) {
+            removeExpiredEntries(now, true);
+        }
+    }
+
+    CacheEntry *entry = entryPool_.createObject(std::string(hostName, hostNameLength)
+                                                , loop_->makeEvent());
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        entryPool_.destroyObject(entry);
+    });
+
+    entryHashTable_.insertNode(entry, hostNameHash);
+    scopeGuard.dismiss();
+    entry->isCached = true;
+    ++entryCount_;
+    return entry;
+}
+
+
+void
+DNSResolver::uncacheEntry(CacheEntry *entry) noexcept
+{
+    SIREN_ASSERT(entry->isCached);
+    entryHashTable_.removeNode(entry);
+    entry->isCached = false;
+    --entryCount_;
+
+    if (entry->referenceCount == 0) {
+        entryPool_.destroyObject(entry);
+    }
+}
+
+
+void
+DNSResolver::uncacheEntries(List *entryList) noexcept
+{
+    while (!entryList->isEmpty()) {
+        auto entry = static_cast<CacheEntry *>(entryList->getHead());
+        entry->remove();
+        uncacheEntry(entry);
+    }
+}
+
+
+void
+DNSResolver::releaseEntry(CacheEntry *entry) noexcept
+{
+    SIREN_ASSERT(entry->referenceCount >= 1);
+
+    if (--entry->referenceCount == 0 && !entry->isCached) {
+        entryPool_.destroyObject(entry);
+    }
+}
+
+
+void
+DNSResolver::removeExpiredEntries(std::chrono::steady_clock::time_point now
+                                  , bool allEntriesAreExpired) noexcept
+{
+    List entryList;
+
+    entryHashTable_.traverse([&] (HashTableNode *hashTableNode) -> void {
+        auto entry = static_cast<CacheEntry *>(hashTableNode);
+
+        if (entry->isResolved && (allEntriesAreExpired || entry->expiryTime <= now)) {
+            entryList.appendNode(entry);
+        }
+    });
+
+    uncacheEntries(&entryList);
+}
+
+
+void
+DNSResolver::resolveEntry(CacheEntry *entry)
+{
+    std::uint32_t address = 0;
+    std::chrono::milliseconds ttl;
+    int errorCode = nameServer_.address == 0
+                    ? lookUpName(entry->hostName.c_str(), &address, &ttl)
+                    : queryNameServer(entry->hostName.c_str(), &address, &ttl);
+
+    if (errorCode == EAI_NONAME || errorCode == EAI_NODATA) {
+        ttl = negativeTTL_;
+    } else if (errorCode != 0) {
+        // transient failures are shared by the coalesced lookups but not cached
+        ttl = std::chrono::milliseconds(0);
+    }
+
+    entry->errorCode = errorCode;
+    entry->address = address;
+    entry->expiryTime = std::chrono::steady_clock::now() + ttl;
+}
+
+
+int
+DNSResolver::lookUpName(const char *hostName, std::uint32_t *address
+                        , std::chrono::milliseconds *ttl)
+{
+    SIREN_ASSERT(async_ != nullptr);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    addrinfo *result;
+    int errorCode = async_->callFunction(AsyncLane::DNS, getaddrinfo, hostName, nullptr, &hints
+                                         , &result);
+
+    if (errorCode != 0) {
+        return errorCode;
+    }
+
+    *address = ntohl(reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(result);
+    // getaddrinfo() does not report record TTLs
+    *ttl = defaultTTL_;
+    return 0;
+}
+
+
+int
+DNSResolver::queryNameServer(const char *hostName, std::uint32_t *address
+                             , std::chrono::milliseconds *ttl)
+{
+    // as with getaddrinfo(), /etc/hosts takes precedence over the name server
+    if (LookUpHostsFile(hostName, address)) {
+        *ttl = defaultTTL_;
+        return 0;
+    }
+
+    unsigned char query[MaxMessageSize];
+    auto queryID = static_cast<std::uint16_t>(randomEngine_());
+    std::size_t querySize = EncodeQuery(hostName, queryID, query);
+
+    if (querySize == 0) {
+        return EAI_NONAME;
+    }
+
+    int fd = loop_->socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "socket() failed");
+    }
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        loop_->close(fd);
+    });
+
+    timeval time;
+    time.tv_sec = queryTimeout_ / 1000;
+    time.tv_usec = (queryTimeout_ % 1000) * 1000;
+
+    if (loop_->setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time)) < 0) {
+        throw std::system_error(errno, std::system_category(), "setsockopt(SO_RCVTIMEO) failed");
+    }
+
+    sockaddr_in name;
+    name.sin_family = AF_INET;
+    name.sin_addr.s_addr = htonl(nameServer_.address);
+    name.sin_port = htons(nameServer_.portNumber);
+    unsigned char reply[MaxMessageSize];
+
+    for (int i = 0; i < maxNumberOfQueries_; ++i) {
+        if (loop_->sendto(fd, query, querySize, 0, reinterpret_cast<sockaddr *>(&name)
+                          , sizeof(name)) < 0) {
+            throw std::system_error(errno, std::system_category(), "sendto() failed");
+        }
+
+        for (;;) {
+            sockaddr_in peerName;
+            socklen_t peerNameSize = sizeof(peerName);
+            ssize_t replySize = loop_->recvfrom(fd, reply, sizeof(reply), 0
+                                                , reinterpret_cast<sockaddr *>(&peerName)
+                                                , &peerNameSize);
+
+            if (replySize < 0) {
+                if (errno == EAGAIN) {
+                    break;
+                }
+
+                throw std::system_error(errno, std::system_category(), "recvfrom() failed");
+            }
+
+            if (peerName.sin_addr.s_addr != name.sin_addr.s_addr
+                || peerName.sin_port != name.sin_port) {
+                continue;
+            }
+
+            int errorCode;
+            std::uint32_t ttlSeconds = 0;
+
+            if (!DecodeReply(reply, replySize, queryID, &errorCode, address, &ttlSeconds)) {
+                continue;
+            }
+
+            *ttl = std::chrono::seconds(ttlSeconds);
+            return errorCode;
+        }
+    }
+
+    return EAI_AGAIN;
+}
+
+
+namespace {
+
+bool
+LookUpHostsFile(const char *hostName, std::uint32_t *address)
+{
+    std::ifstream hostsFile("/etc/hosts");
+    std::string line;
+
+    while (std::getline(hostsFile, line)) {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string field;
+        in_addr lineAddress;
+
+        if (!(fields >> field) || inet_pton(AF_INET, field.c_str(), &lineAddress) != 1) {
+            continue;
+        }
+
+        while (fields >> field) {
+            if (strcasecmp(field.c_str(), hostName) == 0) {
+                *address = ntohl(lineAddress.s_addr);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+std::size_t
+EncodeQuery(const char *hostName, std::uint16_t queryID, unsigned char *query) noexcept
+{
+    static const unsigned char header[] = {
+        0x00, 0x00, // id
+        0x01, 0x00, // rd
+        0x00, 0x01, // qdcount
+        0x00, 0x00, // ancount
+        0x00, 0x00, // nscount
+        0x00, 0x00, // arcount
+    };
+
+    std::memcpy(query, header, sizeof(header));
+    query[0] = queryID >> 8;
+    query[1] = queryID & 0xFF;
+    unsigned char *p = query + sizeof(header);
+    const char *label = hostName;
+
+    for (;;) {
+        const char *labelEnd = std::strchr(label, '.');
+        std::size_t labelLength = labelEnd == nullptr ? std::strlen(label) : labelEnd - label;
+
+        if (labelLength == 0) {
+            if (labelEnd != nullptr || label == hostName) {
+                return 0;
+            }
+
+            break;
+        }
+
+        if (labelLength > 63 || p + 1 + labelLength + 5 > query + 255 + sizeof(header)) {
+            return 0;
+        }
+
+        *p++ = labelLength;
+        std::memcpy(p, label, labelLength);
+        p += labelLength;
+
+        if (labelEnd == nullptr) {
+            break;
+        }
+
+        label = labelEnd + 1;
+    }
+
+    static const unsigned char trailer[] = {
+        0x00,       // root
+        0x00, 0x01, // qtype A
+        0x00, 0x01, // qclass IN
+    };
+
+    std::memcpy(p, trailer, sizeof(trailer));
+    return p + sizeof(trailer) - query;
+}
+
+
+bool
+DecodeReply(const unsigned char *reply, std::size_t replySize, std::uint16_t queryID
+            , int *errorCode, std::uint32_t *address, std::uint32_t *ttl) noexcept
+{
+    if (replySize < 12 || Load16(reply) != queryID || (reply[2] & 0x80) == 0) {
+        return false;
+    }
+
+    *errorCode = DecodeAnswers(reply, replySize, address, ttl);
+    return true;
+}
+
+
+int
+DecodeAnswers(const unsigned char *reply, std::size_t replySize, std::uint32_t *address
+              , std::uint32_t *ttl) noexcept
+{
+    int responseCode = reply[3] & 0x0F;
+
+    if (responseCode == 3) {
+        return EAI_NONAME;
+    }
+
+    if (responseCode != 0) {
+        return EAI_FAIL;
+    }
+
+    const unsigned char *p = reply + 12;
+    const unsigned char *replyEnd = reply + replySize;
+    std::size_t numberOfQuestions = Load16(reply + 4);
+    std::size_t numberOfAnswers = Load16(reply + 6);
+
+    for (; numberOfQuestions >= 1; --numberOfQuestions) {
+        p = SkipName(p, replyEnd);
+
+        if (p == nullptr || replyEnd - p < 4) {
+            return EAI_FAIL;
+        }
+
+        p += 4;
+    }
+
+    bool addressIsFound = false;
+    *ttl = std::numeric_limits<std::uint32_t>::max();
+
+    for (; numberOfAnswers >= 1; --numberOfAnswers) {
+        p = SkipName(p, replyEnd);
+
+        if (p == nullptr || replyEnd - p < 10) {
+            return EAI_FAIL;
+        }
+
+        std::uint16_t type = Load16(p);
+        std::uint16_t class_ = Load16(p + 2);
+        std::uint32_t recordTTL = Load32(p + 4);
+        std::uint16_t dataSize = Load16(p + 8);
+        p += 10;
+
+        if (replyEnd - p < dataSize) {
+            return EAI_FAIL;
+        }
+
+        if (type == 1 && class_ == 1 && dataSize == 4) {
+            if (!addressIsFound) {
+                *address = Load32(p);
+                addressIsFound = true;
+            }
+
+            *ttl = std::min(*ttl, recordTTL);
+        }
+
+        p += dataSize;
+    }
+
+    if (!addressIsFound) {
+        return EAI_NODATA;
+    }
+
+    return 0;
+}
+
+
+const unsigned char *
+SkipName(const unsigned char *p, const unsigned char *end) noexcept
+{
+    while (p < end) {
+        std::size_t labelLength = *p;
+
+        if ((labelLength & 0xC0) == 0xC0) {
+            return end - p < 2 ? nullptr : p + 2;
+        }
+
+        if (labelLength == 0) {
+            return p + 1;
+        }
+
+        p += 1 + labelLength;
+    }
+
+    return nullptr;
+}
+
+
+std::uint16_t
+Load16(const unsigned char *p) noexcept
+{
+    return static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+}
+
+
+std::uint32_t
+Load32(const unsigned char *p) noexcept
+{
+    return static_cast<std::uint32_t>(p[0]) << 24 | static_cast<std::uint32_t>(p[1]) << 16
+           | static_cast<std::uint32_t>(p[2]) << 8 | p[3];
+}
+
+} // namespace
+
+} // namespace siren
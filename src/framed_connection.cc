@@ -0,0 +1,112 @@
+#include "framed_connection.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+
+#include "tcp_socket.h"
+
+
+namespace siren {
+
+namespace {
+
+const std::size_t MaxFramePrefixSize = (std::numeric_limits<std::size_t>::digits + 6) / 7;
+
+} // namespace
+
+
+FramedConnection::FramedConnection(TCPSocket *socket, FramePrefix framePrefix
+                                   , std::size_t maxFrameSize)
+  : socket_(socket),
+    framePrefix_(framePrefix),
+    maxFrameSize_(maxFrameSize)
+{
+    SIREN_ASSERT(socket != nullptr);
+
+    if (framePrefix == FramePrefix::Fixed32
+        && maxFrameSize > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::system_error(EINVAL, std::system_category(), "FramedConnection() failed");
+    }
+}
+
+
+void
+FramedConnection::flush()
+{
+    // all frames written since the last flush leave in as few sends as possible
+    while (outputStream_.getDataSize() >= 1) {
+        socket_->write(&outputStream_);
+    }
+}
+
+
+bool
+FramedConnection::peekFrame(std::size_t *headerSize, std::size_t *frameSize)
+{
+    if (inputStream_.getDataSize() == 0) {
+        return false;
+    }
+
+    Archive archive(&inputStream_);
+    std::size_t temp;
+
+    try {
+        if (framePrefix_ == FramePrefix::VLI) {
+            VLI<std::size_t> prefix;
+            archive >> prefix;
+            temp = prefix;
+        } else {
+            std::uint32_t prefix;
+            archive >> prefix;
+            temp = prefix;
+        }
+    } catch (const EndOfStream &) {
+        return false;
+    }
+
+    if (temp > maxFrameSize_) {
+        throw std::system_error(EMSGSIZE, std::system_category(), "peekFrame() failed");
+    }
+
+    *headerSize = archive.getNumberOfPreReadBytes();
+    *frameSize = temp;
+    std::size_t dataSize = inputStream_.getDataSize();
+
+    if (dataSize < *headerSize + *frameSize) {
+        // make room for the rest of the frame, so large frames arrive in few reads
+        inputStream_.reserveBuffer(*headerSize + *frameSize - dataSize);
+        return false;
+    }
+
+    return true;
+}
+
+
+std::size_t
+FramedConnection::readStream()
+{
+    return socket_->read(&inputStream_);
+}
+
+
+void
+FramedConnection::writeFramePrefix(Archive *archive, std::size_t frameSize)
+{
+    if (frameSize > maxFrameSize_) {
+        throw std::system_error(EMSGSIZE, std::system_category(), "writeFramePrefix() failed");
+    }
+
+    // one reserve for the prefix and the frame, the stores after it never grow the stream
+    outputStream_.reserveBuffer(archive->getNumberOfPreWrittenBytes() + MaxFramePrefixSize
+                                + frameSize);
+
+    if (framePrefix_ == FramePrefix::VLI) {
+        *archive << VLI<std::size_t>(frameSize);
+    } else {
+        *archive << static_cast<std::uint32_t>(frameSize);
+    }
+}
+
+} // namespace siren
@@ -4,7 +4,9 @@
 
 #include <netdb.h>
 
+#include "assert.h"
 #include "async.h"
+#include "dns_resolver.h"
 #include "scope_guard.h"
 
 
@@ -17,7 +19,8 @@ IPEndpoint::ResolveName(Async *async, const char *hostName, const char *serviceN
     std::memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;
     addrinfo *result;
-    int errorCode = async->callFunction(getaddrinfo, hostName, serviceName, &hints, &result);
+    int errorCode = async->callFunction(AsyncLane::DNS, getaddrinfo, hostName, serviceName, &hints
+                                        , &result);
 
     if (errorCode != 0) {
         throw GAIError(errorCode);
@@ -31,6 +34,14 @@ IPEndpoint::ResolveName(Async *async, const char *hostName, const char *serviceN
 }
 
 
+std::uint32_t
+IPEndpoint::ResolveName(DNSResolver *dnsResolver, const char *hostName)
+{
+    SIREN_ASSERT(dnsResolver != nullptr);
+    return dnsResolver->resolveName(hostName);
+}
+
+
 GAIError::GAIError(int code) noexcept
   : code_(code)
 {
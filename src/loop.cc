@@ -60,6 +60,8 @@ struct MyIOTimer
 };
 
 
+const std::size_t SpillBufferSize = 64 * 1024;
+
 bool SetBlocking(int, bool);
 long TimeToTimeout(timeval);
 timeval TimeoutToTime(long);
@@ -413,38 +415,15 @@ int
 Loop::accept4(int fd, sockaddr *name, socklen_t *nameSize, int flags)
 {
     LOOP_CHECK_FD(fd);
+    return acceptSocket(fd, getEffectiveReadTimeout(fd), name, nameSize, flags);
+}
 
-    for (;;) {
-        int subFD = ::accept4(fd, name, nameSize, flags | SOCK_NONBLOCK);
-
-        if (subFD < 0) {
-            if (errno == EAGAIN) {
-                if (!waitForFile(fd, IOCondition::In, nullptr
-                                 , std::chrono::milliseconds(getEffectiveReadTimeout(fd)))) {
-                    errno = EAGAIN;
-                    return -1;
-                }
-            } else {
-                if (errno != EINTR) {
-                    return -1;
-                }
-            }
-        } else {
-            auto scopeGuard = MakeScopeGuard([&] () -> void {
-                if (::close(subFD) < 0 && errno != EINTR) {
-                    std::perror("close() failed");
-                    std::terminate();
-                }
-            });
 
-            bool blocking = (flags & SOCK_NONBLOCK) == 0;
-            FileOptions *fileOptions = getFileOptions(fd);
-            createIOContext(subFD, true, blocking, fileOptions->readTimeout
-                            , fileOptions->writeTimeout);
-            scopeGuard.dismiss();
-            return subFD;
-        }
-    }
+int
+Loop::tryAccept4(int fd, sockaddr *name, socklen_t *nameSize, int flags)
+{
+    LOOP_CHECK_FD(fd);
+    return acceptSocket(fd, 0, name, nameSize, flags);
 }
 
 
@@ -455,26 +434,7 @@ Loop::connect(int fd, const sockaddr *name, socklen_t nameSize)
 
     if (::connect(fd, name, nameSize) < 0) {
         if (errno == EINTR || errno == EINPROGRESS) {
-            if (waitForFile(fd, IOCondition::Out, nullptr
-                            , std::chrono::milliseconds(getEffectiveWriteTimeout(fd)))) {
-                int errorNumber;
-                socklen_t errorNumberSize = sizeof(errorNumber);
-
-                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &errorNumber, &errorNumberSize) < 0) {
-                    throw std::system_error(errno, std::system_category()
-                                            , "getsockopt(SO_ERROR) failed");
-                }
-
-                if (errorNumber == 0) {
-                    return 0;
-                } else {
-                    errno = errorNumber;
-                    return -1;
-                }
-            } else {
-                errno = EINPROGRESS;
-                return -1;
-            }
+            return waitForConnection(fd, getEffectiveWriteTimeout(fd));
         } else {
             return -1;
         }
@@ -596,10 +556,47 @@ Loop::sendto(int fd, const void *data, size_t dataSize, int flags, const sockadd
         timeout = getEffectiveWriteTimeout(fd);
     }
 
+    if ((flags & MSG_FASTOPEN) == MSG_FASTOPEN) {
+        ssize_t numberOfBytes = ::sendto(fd, data, dataSize, flags, name, nameSize);
+
+        if (numberOfBytes >= 0) {
+            return numberOfBytes;
+        }
+
+        if (errno != EINTR && errno != EINPROGRESS) {
+            return -1;
+        }
+
+        if (waitForConnection(fd, timeout) < 0) {
+            return -1;
+        }
+
+        flags &= ~MSG_FASTOPEN;
+        name = nullptr;
+        nameSize = 0;
+    }
+
     return writeFile(fd, timeout, ::sendto, data, dataSize, flags, name, nameSize);
 }
 
 
+ssize_t
+Loop::sendmsg(int fd, const msghdr *message, int flags)
+{
+    LOOP_CHECK_FD(fd);
+    long timeout;
+
+    if ((flags & MSG_DONTWAIT) == MSG_DONTWAIT) {
+        flags &= ~MSG_DONTWAIT;
+        timeout = 0;
+    } else {
+        timeout = getEffectiveWriteTimeout(fd);
+    }
+
+    return writeFile(fd, timeout, ::sendmsg, message, flags);
+}
+
+
 int
 Loop::close(int fd) noexcept
 {
@@ -675,6 +672,19 @@ Loop::poll(pollfd *pollFDs, nfds_t numberOfPollFDs, int timeout)
 }
 
 
+char *
+Loop::getSpillBuffer(std::size_t *spillBufferSize)
+{
+    // allocated on first use, loops which never read into streams don't pay for it
+    if (spillBuffer_.getLength() == 0) {
+        spillBuffer_.setLength(SpillBufferSize);
+    }
+
+    *spillBufferSize = spillBuffer_.getLength();
+    return spillBuffer_;
+}
+
+
 
 template <class T, class ...U>
 ssize_t
@@ -858,6 +868,30 @@ Loop::waitForFile(int fd, IOCondition ioConditions, IOCondition *readyIOConditio
 }
 
 
+int
+Loop::waitForConnection(int fd, long timeout)
+{
+    if (waitForFile(fd, IOCondition::Out, nullptr, std::chrono::milliseconds(timeout))) {
+        int errorNumber;
+        socklen_t errorNumberSize = sizeof(errorNumber);
+
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &errorNumber, &errorNumberSize) < 0) {
+            throw std::system_error(errno, std::system_category(), "getsockopt(SO_ERROR) failed");
+        }
+
+        if (errorNumber == 0) {
+            return 0;
+        } else {
+            errno = errorNumber;
+            return -1;
+        }
+    } else {
+        errno = EINPROGRESS;
+        return -1;
+    }
+}
+
+
 void
 Loop::setDelay(std::chrono::milliseconds duration)
 {
@@ -892,6 +926,43 @@ Loop::setDelay(std::chrono::milliseconds duration)
 }
 
 
+int
+Loop::acceptSocket(int fd, long timeout, sockaddr *name, socklen_t *nameSize, int flags)
+{
+    for (;;) {
+        int subFD = ::accept4(fd, name, nameSize, flags | SOCK_NONBLOCK);
+
+        if (subFD < 0) {
+            if (errno == EAGAIN) {
+                if (!waitForFile(fd, IOCondition::In, nullptr
+                                 , std::chrono::milliseconds(timeout))) {
+                    errno = EAGAIN;
+                    return -1;
+                }
+            } else {
+                if (errno != EINTR) {
+                    return -1;
+                }
+            }
+        } else {
+            auto scopeGuard = MakeScopeGuard([&] () -> void {
+                if (::close(subFD) < 0 && errno != EINTR) {
+                    std::perror("close() failed");
+                    std::terminate();
+                }
+            });
+
+            bool blocking = (flags & SOCK_NONBLOCK) == 0;
+            FileOptions *fileOptions = getFileOptions(fd);
+            createIOContext(subFD, true, blocking, fileOptions->readTimeout
+                            , fileOptions->writeTimeout);
+            scopeGuard.dismiss();
+            return subFD;
+        }
+    }
+}
+
+
 namespace {
 
 bool
@@ -0,0 +1,233 @@
+#include "segmented_stream.h"
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "assert.h"
+
+
+namespace siren {
+
+SegmentedStream::SegmentedStream(std::size_t segmentSize) noexcept
+  : segmentCapacity_(segmentSize - sizeof(Segment)),
+    segmentPool_(alignof(Segment), segmentSize)
+{
+    SIREN_ASSERT(segmentSize > sizeof(Segment));
+    initialize();
+}
+
+
+SegmentedStream::SegmentedStream(SegmentedStream &&other) noexcept
+  : segmentCapacity_(other.segmentCapacity_),
+    segmentPool_(std::move(other.segmentPool_)),
+    segmentList_(std::move(other.segmentList_))
+{
+    other.move(this);
+}
+
+
+SegmentedStream &
+SegmentedStream::operator=(SegmentedStream &&other) noexcept
+{
+    if (&other != this) {
+        SIREN_ASSERT(segmentCapacity_ == other.segmentCapacity_);
+        segmentPool_ = std::move(other.segmentPool_);
+        segmentList_ = std::move(other.segmentList_);
+        other.move(this);
+    }
+
+    return *this;
+}
+
+
+void
+SegmentedStream::initialize() noexcept
+{
+    segmentCount_ = 0;
+    dataOffset_ = 0;
+    dataSize_ = 0;
+    bufferSegment_ = nullptr;
+    bufferOffset_ = 0;
+    bufferSize_ = 0;
+}
+
+
+void
+SegmentedStream::move(SegmentedStream *other) noexcept
+{
+    other->segmentCount_ = segmentCount_;
+    other->dataOffset_ = dataOffset_;
+    other->dataSize_ = dataSize_;
+    other->bufferSegment_ = bufferSegment_;
+    other->bufferOffset_ = bufferOffset_;
+    other->bufferSize_ = bufferSize_;
+    initialize();
+}
+
+
+void
+SegmentedStream::reset() noexcept
+{
+    segmentList_.reset();
+    segmentPool_.reset();
+    initialize();
+}
+
+
+void
+SegmentedStream::commitBuffer(std::size_t bufferSize) noexcept
+{
+    SIREN_ASSERT(bufferSize <= bufferSize_);
+    dataSize_ += bufferSize;
+    bufferSize_ -= bufferSize;
+    bufferOffset_ += bufferSize;
+
+    if (bufferSize_ == 0) {
+        return;
+    }
+
+    while (bufferOffset_ >= segmentCapacity_) {
+        bufferSegment_ = static_cast<Segment *>(bufferSegment_->getNext());
+        bufferOffset_ -= segmentCapacity_;
+    }
+}
+
+
+void
+SegmentedStream::discardData(std::size_t dataSize) noexcept
+{
+    SIREN_ASSERT(dataSize <= dataSize_);
+    dataOffset_ += dataSize;
+    dataSize_ -= dataSize;
+
+    // whole segments go back to the pool, nothing is ever copied
+    while (dataOffset_ >= segmentCapacity_) {
+        auto segment = static_cast<Segment *>(segmentList_.getHead());
+        segment->remove();
+        segmentPool_.freeBlock(segment);
+        --segmentCount_;
+        dataOffset_ -= segmentCapacity_;
+    }
+
+    if (dataSize_ == 0) {
+        rewind();
+    }
+}
+
+
+void
+SegmentedStream::rewind() noexcept
+{
+    dataOffset_ = 0;
+
+    if (segmentCount_ == 0) {
+        bufferSegment_ = nullptr;
+        bufferOffset_ = 0;
+        bufferSize_ = 0;
+    } else {
+        bufferSegment_ = static_cast<Segment *>(segmentList_.getHead());
+        bufferOffset_ = 0;
+        bufferSize_ = segmentCount_ * segmentCapacity_;
+    }
+}
+
+
+void
+SegmentedStream::reserveBuffer(std::size_t bufferSize)
+{
+    while (bufferSize_ < bufferSize) {
+        auto segment = new (segmentPool_.allocateBlock()) Segment();
+        segmentList_.appendNode(segment);
+        ++segmentCount_;
+
+        if (bufferSize_ == 0) {
+            bufferSegment_ = segment;
+            bufferOffset_ = 0;
+        }
+
+        bufferSize_ += segmentCapacity_;
+    }
+}
+
+
+void
+SegmentedStream::read(void *buffer, std::size_t bufferSize) noexcept
+{
+    SIREN_ASSERT(bufferSize <= dataSize_);
+    auto segment = static_cast<Segment *>(segmentList_.getHead());
+    std::size_t offset = dataOffset_;
+
+    for (std::size_t i = 0; i < bufferSize;) {
+        std::size_t n = std::min(bufferSize - i, segmentCapacity_ - offset);
+        std::memcpy(static_cast<char *>(buffer) + i, GetSegmentData(segment) + offset, n);
+        i += n;
+        segment = static_cast<Segment *>(segment->getNext());
+        offset = 0;
+    }
+
+    discardData(bufferSize);
+}
+
+
+void
+SegmentedStream::write(const void *data, std::size_t dataSize)
+{
+    reserveBuffer(dataSize);
+    Segment *segment = bufferSegment_;
+    std::size_t offset = bufferOffset_;
+
+    for (std::size_t i = 0; i < dataSize;) {
+        std::size_t n = std::min(dataSize - i, segmentCapacity_ - offset);
+        std::memcpy(GetSegmentData(segment) + offset, static_cast<const char *>(data) + i, n);
+        i += n;
+        segment = static_cast<Segment *>(segment->getNext());
+        offset = 0;
+    }
+
+    commitBuffer(dataSize);
+}
+
+
+int
+SegmentedStream::getDataVector(iovec *vector, int vectorLength) const noexcept
+{
+    auto segment = static_cast<const Segment *>(segmentList_.getHead());
+    std::size_t offset = dataOffset_;
+    std::size_t dataSize = dataSize_;
+    int i;
+
+    for (i = 0; i < vectorLength && dataSize >= 1; ++i) {
+        std::size_t n = std::min(dataSize, segmentCapacity_ - offset);
+        vector[i].iov_base = const_cast<char *>(GetSegmentData(segment)) + offset;
+        vector[i].iov_len = n;
+        dataSize -= n;
+        segment = static_cast<const Segment *>(segment->getNext());
+        offset = 0;
+    }
+
+    return i;
+}
+
+
+int
+SegmentedStream::getBufferVector(iovec *vector, int vectorLength) noexcept
+{
+    Segment *segment = bufferSegment_;
+    std::size_t offset = bufferOffset_;
+    std::size_t bufferSize = bufferSize_;
+    int i;
+
+    for (i = 0; i < vectorLength && bufferSize >= 1; ++i) {
+        std::size_t n = std::min(bufferSize, segmentCapacity_ - offset);
+        vector[i].iov_base = GetSegmentData(segment) + offset;
+        vector[i].iov_len = n;
+        bufferSize -= n;
+        segment = static_cast<Segment *>(segment->getNext());
+        offset = 0;
+    }
+
+    return i;
+}
+
+} // namespace siren
@@ -1,28 +1,63 @@
 #include "stream.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <exception>
+#include <system_error>
 #include <utility>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "scope_guard.h"
+#include "utility.h"
+
 
 namespace siren {
 
-Stream::Stream() noexcept
+namespace {
+
+const int ShrinkPeriod = 16;
+const std::size_t MinShrinkableSize = 4096;
+
+} // namespace
+
+
+Stream::Stream(StreamStorage storage) noexcept
+  : storage_(storage)
 {
+#ifdef SIREN_WITH_DEBUG
+    generation_ = 0;
+#endif
     initialize();
 }
 
 
 Stream::Stream(Stream &&other) noexcept
-  : base_(std::move(other.base_))
+  : storage_(other.storage_),
+    base_(std::move(other.base_))
 {
+#ifdef SIREN_WITH_DEBUG
+    generation_ = 0;
+#endif
     other.move(this);
 }
 
 
+Stream::~Stream()
+{
+    finalize();
+}
+
+
 Stream &
 Stream::operator=(Stream &&other) noexcept
 {
     if (&other != this) {
+        finalize();
+        storage_ = other.storage_;
         base_ = std::move(other.base_);
         other.move(this);
     }
@@ -34,16 +69,44 @@ Stream::operator=(Stream &&other) noexcept
 void
 Stream::initialize() noexcept
 {
+    ring_ = nullptr;
+    ringSize_ = 0;
+    data_ = nullptr;
     dataOffset_ = 0;
     bufferOffset_ = 0;
+    bufferLimit_ = 0;
+    peakDataSize_ = 0;
+    idleCount_ = 0;
+#ifdef SIREN_WITH_DEBUG
+    ++generation_;
+#endif
+}
+
+
+void
+Stream::finalize() noexcept
+{
+    if (ring_ != nullptr && munmap(ring_, 2 * ringSize_) < 0) {
+        std::perror("munmap() failed");
+        std::terminate();
+    }
 }
 
 
 void
 Stream::move(Stream *other) noexcept
 {
+    other->ring_ = ring_;
+    other->ringSize_ = ringSize_;
+    other->data_ = storage_ == StreamStorage::Ring ? ring_ : other->base_;
     other->dataOffset_ = dataOffset_;
     other->bufferOffset_ = bufferOffset_;
+    other->bufferLimit_ = bufferLimit_;
+    other->peakDataSize_ = peakDataSize_;
+    other->idleCount_ = idleCount_;
+#ifdef SIREN_WITH_DEBUG
+    ++other->generation_;
+#endif
     initialize();
 }
 
@@ -52,6 +115,7 @@ void
 Stream::reset() noexcept
 {
     base_.reset();
+    finalize();
     initialize();
 }
 
@@ -60,28 +124,144 @@ void
 Stream::discardData(std::size_t dataSize) noexcept
 {
     SIREN_ASSERT(dataOffset_ + dataSize <= bufferOffset_);
+    peakDataSize_ = std::max(peakDataSize_, bufferOffset_ - dataOffset_);
     dataOffset_ += dataSize;
+#ifdef SIREN_WITH_DEBUG
+    // views into the data die here
+    ++generation_;
+#endif
+
+    if (storage_ == StreamStorage::Ring) {
+        // the second mapping makes the wrapped data contiguous, so just rotate the offsets
+        if (dataOffset_ >= ringSize_) {
+            dataOffset_ -= ringSize_;
+            bufferOffset_ -= ringSize_;
+        }
+
+        bufferLimit_ = dataOffset_ + ringSize_;
+        return;
+    }
 
     if (dataOffset_ >= bufferOffset_ - dataOffset_) {
         std::memcpy(base_, base_ + dataOffset_, bufferOffset_ - dataOffset_);
         bufferOffset_ -= dataOffset_;
         dataOffset_ = 0;
+
+        if (bufferOffset_ == 0) {
+            shrinkBase();
+        }
+    }
+}
+
+
+void
+Stream::shrinkBase() noexcept
+{
+    if (++idleCount_ < ShrinkPeriod) {
+        return;
     }
+
+    // give the memory back only if the stream has stayed mostly empty for the whole period
+    if (base_.getLength() > MinShrinkableSize && peakDataSize_ <= base_.getLength() / 4) {
+        base_.shrinkLength(peakDataSize_);
+        data_ = base_;
+        bufferLimit_ = base_.getLength();
+    }
+
+    peakDataSize_ = 0;
+    idleCount_ = 0;
 }
 
 
 void
 Stream::reserveBuffer(std::size_t bufferSize)
 {
-    if (base_.getLength() < bufferOffset_ + bufferSize) {
-        if (base_.getLength() < bufferOffset_ - dataOffset_ + bufferSize) {
-            base_.setLength(bufferOffset_ + bufferSize);
-        } else {
-            std::memmove(base_, base_ + dataOffset_, bufferOffset_ - dataOffset_);
-            bufferOffset_ -= dataOffset_;
-            dataOffset_ = 0;
+    peakDataSize_ = std::max(peakDataSize_, bufferOffset_ - dataOffset_ + bufferSize);
+
+    if (bufferLimit_ - bufferOffset_ >= bufferSize) {
+        return;
+    }
+
+#ifdef SIREN_WITH_DEBUG
+    ++generation_;
+#endif
+
+    if (storage_ == StreamStorage::Ring) {
+        reserveRing(bufferOffset_ - dataOffset_ + bufferSize);
+        return;
+    }
+
+    if (base_.getLength() < bufferOffset_ - dataOffset_ + bufferSize) {
+        base_.setLength(bufferOffset_ + bufferSize);
+        data_ = base_;
+        bufferLimit_ = base_.getLength();
+    } else {
+        std::memmove(base_, base_ + dataOffset_, bufferOffset_ - dataOffset_);
+        bufferOffset_ -= dataOffset_;
+        dataOffset_ = 0;
+    }
+}
+
+
+void
+Stream::reserveRing(std::size_t ringSize)
+{
+    static const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    ringSize = AlignSize(NextPowerOfTwo(ringSize), pageSize);
+    int fd = memfd_create("siren-stream", MFD_CLOEXEC);
+
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "memfd_create() failed");
+    }
+
+    auto scopeGuard1 = MakeScopeGuard([&] () -> void {
+        if (close(fd) < 0 && errno != EINTR) {
+            std::perror("close() failed");
+            std::terminate();
         }
+    });
+
+    if (ftruncate(fd, ringSize) < 0) {
+        throw std::system_error(errno, std::system_category(), "ftruncate() failed");
+    }
+
+    // reserve 2 * ringSize bytes of address space, then map the same pages into both halves
+    void *address = mmap(nullptr, 2 * ringSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (address == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(), "mmap() failed");
     }
+
+    auto ring = static_cast<char *>(address);
+
+    auto scopeGuard2 = MakeScopeGuard([&] () -> void {
+        if (munmap(ring, 2 * ringSize) < 0) {
+            std::perror("munmap() failed");
+            std::terminate();
+        }
+    });
+
+    for (int i = 0; i < 2; ++i) {
+        if (mmap(ring + i * ringSize, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd
+                 , 0) == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "mmap() failed");
+        }
+    }
+
+    std::size_t dataSize = bufferOffset_ - dataOffset_;
+
+    if (dataSize >= 1) {
+        std::memcpy(ring, getData(), dataSize);
+    }
+
+    scopeGuard2.dismiss();
+    finalize();
+    ring_ = ring;
+    ringSize_ = ringSize;
+    data_ = ring;
+    dataOffset_ = 0;
+    bufferOffset_ = dataSize;
+    bufferLimit_ = ringSize;
 }
 
 
@@ -0,0 +1,283 @@
+#include "tcp_connection_pool.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+#include <sys/socket.h>
+
+#include "assert.h"
+#include "loop.h"
+#include "scope_guard.h"
+
+
+namespace siren {
+
+TCPConnectionPool::TCPConnectionPool(Loop *loop, std::size_t maxNumberOfConnections
+                                     , std::size_t minNumberOfIdleConnections
+                                     , std::size_t maxNumberOfIdleConnections, long idleTimeout)
+  : loop_(loop),
+    maxNumberOfConnections_(maxNumberOfConnections),
+    minNumberOfIdleConnections_(minNumberOfIdleConnections),
+    maxNumberOfIdleConnections_(maxNumberOfIdleConnections == 0
+                                ? std::numeric_limits<std::size_t>::max()
+                                : maxNumberOfIdleConnections),
+    idleTimeout_(idleTimeout)
+{
+    SIREN_ASSERT(loop != nullptr);
+    SIREN_ASSERT(minNumberOfIdleConnections_ <= maxNumberOfIdleConnections_);
+    initialize();
+}
+
+
+TCPConnectionPool::~TCPConnectionPool()
+{
+    finalize();
+}
+
+
+void
+TCPConnectionPool::initialize()
+{
+    if (idleTimeout_.count() >= 1) {
+        fiberHandle_ = loop_->createFiber(std::bind(&TCPConnectionPool::idleConnectionReaper
+                                                    , this), 0, true);
+    } else {
+        fiberHandle_ = nullptr;
+    }
+}
+
+
+void
+TCPConnectionPool::finalize() noexcept
+{
+    if (fiberHandle_ != nullptr) {
+        loop_->interruptFiber(fiberHandle_);
+    }
+
+    List slotList;
+
+    // removing nodes while traversing the hash table would skip some of them
+    slotHashTable_.traverse([&] (HashTableNode *hashTableNode) -> void {
+        auto slot = static_cast<Slot *>(hashTableNode);
+        SIREN_ASSERT(slot->numberOfBusyConnections == 0);
+        slotList.appendNode(slot);
+    });
+
+    destroySlots(&slotList);
+}
+
+
+std::size_t
+TCPConnectionPool::HashIPEndpoint(const IPEndpoint &ipEndpoint) noexcept
+{
+    return std::hash<std::uint64_t>()(static_cast<std::uint64_t>(ipEndpoint.address) << 16
+                                      | ipEndpoint.portNumber);
+}
+
+
+const detail::TCPConnectionPoolSlot *
+TCPConnectionPool::findSlot(const IPEndpoint &ipEndpoint) const noexcept
+{
+    const HashTableNode *hashTableNode = slotHashTable_.search(
+        HashIPEndpoint(ipEndpoint),
+
+        [&] (const HashTableNode *hashTableNode) -> bool {
+            auto slot = static_cast<const Slot *>(hashTableNode);
+            return slot->ipEndpoint.address == ipEndpoint.address
+                   && slot->ipEndpoint.portNumber == ipEndpoint.portNumber;
+        }
+    );
+
+    return static_cast<const Slot *>(hashTableNode);
+}
+
+
+detail::TCPConnectionPoolSlot *
+TCPConnectionPool::findSlot(const IPEndpoint &ipEndpoint) noexcept
+{
+    HashTableNode *hashTableNode = slotHashTable_.search(
+        HashIPEndpoint(ipEndpoint),
+
+        [&] (const HashTableNode *hashTableNode) -> bool {
+            auto slot = static_cast<const Slot *>(hashTableNode);
+            return slot->ipEndpoint.address == ipEndpoint.address
+                   && slot->ipEndpoint.portNumber == ipEndpoint.portNumber;
+        }
+    );
+
+    return static_cast<Slot *>(hashTableNode);
+}
+
+
+detail::TCPConnectionPoolSlot *
+TCPConnectionPool::getSlot(const IPEndpoint &ipEndpoint)
+{
+    Slot *slot = findSlot(ipEndpoint);
+
+    if (slot == nullptr) {
+        std::intmax_t maxValue = maxNumberOfConnections_ == 0
+                                 ? std::numeric_limits<std::intmax_t>::max()
+                                 : maxNumberOfConnections_;
+        slot = slotPool_.createObject(ipEndpoint, loop_->makeSemaphore(maxValue, 0, maxValue));
+
+        auto scopeGuard = MakeScopeGuard([&] () -> void {
+            slotPool_.destroyObject(slot);
+        });
+
+        slotHashTable_.insertNode(slot, HashIPEndpoint(ipEndpoint));
+        scopeGuard.dismiss();
+    }
+
+    return slot;
+}
+
+
+void
+TCPConnectionPool::destroySlot(Slot *slot) noexcept
+{
+    while (!slot->idleConnectionList.isEmpty()) {
+        auto idleConnection = static_cast<IdleConnection *>(slot->idleConnectionList.getHead());
+        idleConnection->remove();
+        idleConnectionPool_.destroyObject(idleConnection);
+    }
+
+    slotHashTable_.removeNode(slot);
+    slotPool_.destroyObject(slot);
+}
+
+
+void
+TCPConnectionPool::destroySlots(List *slotList) noexcept
+{
+    while (!slotList->isEmpty()) {
+        auto slot = static_cast<Slot *>(slotList->getHead());
+        slot->remove();
+        destroySlot(slot);
+    }
+}
+
+
+TCPSocket
+TCPConnectionPool::acquireConnection(const IPEndpoint &ipEndpoint)
+{
+    Slot *slot = getSlot(ipEndpoint);
+    slot->semaphore.down();
+    ++slot->numberOfBusyConnections;
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        --slot->numberOfBusyConnections;
+        slot->semaphore.up();
+    });
+
+    while (!slot->idleConnectionList.isEmpty()) {
+        auto idleConnection = static_cast<IdleConnection *>(slot->idleConnectionList.getTail());
+        idleConnection->remove();
+        --slot->numberOfIdleConnections;
+        TCPSocket socket = std::move(idleConnection->socket);
+        idleConnectionPool_.destroyObject(idleConnection);
+
+        if (connectionIsAlive(socket)) {
+            scopeGuard.dismiss();
+            return socket;
+        }
+    }
+
+    TCPSocket socket(loop_);
+    socket.connect(ipEndpoint);
+    scopeGuard.dismiss();
+    return socket;
+}
+
+
+void
+TCPConnectionPool::releaseConnection(const IPEndpoint &ipEndpoint, TCPSocket &&socket
+                                     , bool socketIsReusable)
+{
+    Slot *slot = findSlot(ipEndpoint);
+    SIREN_ASSERT(slot != nullptr);
+    SIREN_ASSERT(slot->numberOfBusyConnections >= 1);
+
+    auto scopeGuard = MakeScopeGuard([&] () -> void {
+        --slot->numberOfBusyConnections;
+        slot->semaphore.up();
+    });
+
+    if (socketIsReusable && socket.isValid()
+        && slot->numberOfIdleConnections < maxNumberOfIdleConnections_) {
+        auto idleConnection = idleConnectionPool_.createObject(std::move(socket));
+        idleConnection->idleTime = std::chrono::steady_clock::now();
+        slot->idleConnectionList.appendNode(idleConnection);
+        ++slot->numberOfIdleConnections;
+    }
+}
+
+
+std::size_t
+TCPConnectionPool::getNumberOfIdleConnections(const IPEndpoint &ipEndpoint) const noexcept
+{
+    const Slot *slot = findSlot(ipEndpoint);
+    return slot == nullptr ? 0 : slot->numberOfIdleConnections;
+}
+
+
+bool
+TCPConnectionPool::connectionIsAlive(const TCPSocket &socket) noexcept
+{
+    char dummy;
+
+    if (loop_->recv(socket.getFD(), &dummy, sizeof(dummy), MSG_PEEK | MSG_DONTWAIT) < 0) {
+        return errno == EAGAIN;
+    } else {
+        return false;
+    }
+}
+
+
+void
+TCPConnectionPool::idleConnectionReaper() noexcept
+{
+    for (;;) {
+        try {
+            loop_->usleep(idleTimeout_.count() * 1000);
+        } catch (FiberInterruption) {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        List slotList;
+
+        slotHashTable_.traverse([&] (HashTableNode *hashTableNode) -> void {
+            auto slot = static_cast<Slot *>(hashTableNode);
+            removeExpiredIdleConnections(slot, now);
+
+            if (slot->numberOfBusyConnections == 0 && slot->numberOfIdleConnections == 0) {
+                slotList.appendNode(slot);
+            }
+        });
+
+        destroySlots(&slotList);
+    }
+}
+
+
+void
+TCPConnectionPool::removeExpiredIdleConnections(Slot *slot
+                                                , std::chrono::steady_clock::time_point now)
+    noexcept
+{
+    while (slot->numberOfIdleConnections > minNumberOfIdleConnections_) {
+        auto idleConnection = static_cast<IdleConnection *>(slot->idleConnectionList.getHead());
+
+        if (idleConnection->idleTime + idleTimeout_ > now) {
+            return;
+        }
+
+        idleConnection->remove();
+        --slot->numberOfIdleConnections;
+        idleConnectionPool_.destroyObject(idleConnection);
+    }
+}
+
+} // namespace siren
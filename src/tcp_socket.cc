@@ -2,21 +2,61 @@
 
 #include <cerrno>
 #include <algorithm>
+#include <cstdint>
 #include <system_error>
 
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 
 #include "assert.h"
 #include "loop.h"
+#include "segmented_stream.h"
 #include "stream.h"
 
 
 namespace siren {
 
+namespace {
+
+const std::size_t MaxExpectedReadSize = 64 * 1024;
+
+} // namespace
+
+
+std::vector<TCPSocket>
+TCPSocket::ListenShards(const std::vector<Loop *> &loops, const IPEndpoint &ipEndpoint
+                        , bool cpuAffinity, int backlog)
+{
+    SIREN_ASSERT(!loops.empty());
+    std::vector<TCPSocket> shards;
+    shards.reserve(loops.size());
+    IPEndpoint shardIPEndpoint = ipEndpoint;
+
+    for (Loop *loop : loops) {
+        shards.emplace_back(loop);
+        TCPSocket *shard = &shards.back();
+        shard->setReuseAddress(true);
+        shard->setReusePort(true);
+        shard->listen(shardIPEndpoint, backlog);
+
+        if (shardIPEndpoint.portNumber == 0) {
+            shardIPEndpoint.portNumber = shard->getLocalEndpoint().portNumber;
+        }
+    }
+
+    if (cpuAffinity) {
+        shards.front().setReusePortCPUAffinity(shards.size());
+    }
+
+    return shards;
+}
+
+
 TCPSocket::TCPSocket(Loop *loop)
-  : loop_(loop)
+  : loop_(loop),
+    expectedReadSize_(0)
 {
     SIREN_ASSERT(loop != nullptr);
     initialize();
@@ -25,7 +65,8 @@ TCPSocket::TCPSocket(Loop *loop)
 
 TCPSocket::TCPSocket(Loop *loop, int fd) noexcept
   : loop_(loop),
-    fd_(fd)
+    fd_(fd),
+    expectedReadSize_(0)
 {
 }
 
@@ -49,7 +90,10 @@ TCPSocket &
 TCPSocket::operator=(TCPSocket &&other) noexcept
 {
     if (&other != this) {
-        finalize();
+        if (isValid()) {
+            finalize();
+        }
+
         loop_ = other.loop_;
         other.move(this);
     }
@@ -83,6 +127,7 @@ void
 TCPSocket::move(TCPSocket *other) noexcept
 {
     other->fd_ = fd_;
+    other->expectedReadSize_ = expectedReadSize_;
     fd_ = -1;
 }
 
@@ -98,6 +143,39 @@ TCPSocket::setReuseAddress(bool reuseAddress)
 }
 
 
+void
+TCPSocket::setReusePort(bool reusePort)
+{
+    int onOff = reusePort;
+
+    if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &onOff, sizeof(onOff)) < 0) {
+        throw std::system_error(errno, std::system_category(), "setsockopt(SO_REUSEPORT) failed");
+    }
+}
+
+
+void
+TCPSocket::setReusePortCPUAffinity(unsigned int numberOfShards)
+{
+    SIREN_ASSERT(numberOfShards >= 1);
+
+    sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, numberOfShards},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+
+    sock_fprog program;
+    program.len = sizeof(code) / sizeof(code[0]);
+    program.filter = code;
+
+    if (setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0) {
+        throw std::system_error(errno, std::system_category()
+                                , "setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed");
+    }
+}
+
+
 void
 TCPSocket::setNoDelay(bool noDelay)
 {
@@ -201,6 +279,41 @@ TCPSocket::setSendBufferSize(int sendBufferSize)
 }
 
 
+void
+TCPSocket::setFastOpen(int queueLength)
+{
+    SIREN_ASSERT(queueLength >= 0);
+
+    if (setsockopt(fd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLength, sizeof(queueLength)) < 0) {
+        throw std::system_error(errno, std::system_category(), "setsockopt(TCP_FASTOPEN) failed");
+    }
+}
+
+
+void
+TCPSocket::setFastOpenConnect(bool fastOpenConnect)
+{
+    int onOff = fastOpenConnect;
+
+    if (setsockopt(fd_, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &onOff, sizeof(onOff)) < 0) {
+        throw std::system_error(errno, std::system_category()
+                                , "setsockopt(TCP_FASTOPEN_CONNECT) failed");
+    }
+}
+
+
+void
+TCPSocket::setDeferAccept(int timeout)
+{
+    SIREN_ASSERT(timeout >= 0);
+
+    if (setsockopt(fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &timeout, sizeof(timeout)) < 0) {
+        throw std::system_error(errno, std::system_category()
+                                , "setsockopt(TCP_DEFER_ACCEPT) failed");
+    }
+}
+
+
 void
 TCPSocket::listen(const IPEndpoint &ipEndpoint, int backlog)
 {
@@ -240,6 +353,30 @@ TCPSocket::accept(IPEndpoint *ipEndpoint)
 }
 
 
+TCPSocket
+TCPSocket::tryAccept(IPEndpoint *ipEndpoint)
+{
+    SIREN_ASSERT(isValid());
+    sockaddr_in name;
+    socklen_t nameSize = sizeof(name);
+    int subFD = loop_->tryAccept4(fd_, reinterpret_cast<sockaddr *>(&name), &nameSize, 0);
+
+    if (subFD < 0) {
+        if (errno == EAGAIN) {
+            return TCPSocket(loop_, -1);
+        }
+
+        throw std::system_error(errno, std::system_category(), "accept4() failed");
+    }
+
+    if (ipEndpoint != nullptr) {
+        *ipEndpoint = IPEndpoint(name);
+    }
+
+    return TCPSocket(loop_, subFD);
+}
+
+
 void
 TCPSocket::connect(const IPEndpoint &ipEndpoint)
 {
@@ -255,6 +392,37 @@ TCPSocket::connect(const IPEndpoint &ipEndpoint)
 }
 
 
+std::size_t
+TCPSocket::connectAndWrite(const IPEndpoint &ipEndpoint, const void *data, std::size_t dataSize)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(data != nullptr || dataSize == 0);
+    sockaddr_in name;
+    name.sin_family = AF_INET;
+    name.sin_addr.s_addr = htonl(ipEndpoint.address);
+    name.sin_port = htons(ipEndpoint.portNumber);
+    ssize_t numberOfBytes = loop_->sendto(fd_, data, dataSize, MSG_FASTOPEN | MSG_NOSIGNAL
+                                          , reinterpret_cast<sockaddr *>(&name), sizeof(name));
+
+    if (numberOfBytes < 0) {
+        if (errno != EOPNOTSUPP) {
+            throw std::system_error(errno, std::system_category()
+                                    , "sendto(MSG_FASTOPEN) failed");
+        }
+
+        connect(ipEndpoint);
+        numberOfBytes = 0;
+    }
+
+    // the SYN may carry only part of the data, whichever way it went the rest is written out
+    for (std::size_t n = numberOfBytes; n < dataSize;) {
+        n += write(static_cast<const char *>(data) + n, dataSize - n);
+    }
+
+    return dataSize;
+}
+
+
 IPEndpoint
 TCPSocket::getLocalEndpoint() const
 {
@@ -320,8 +488,29 @@ TCPSocket::read(Stream *stream)
 {
     SIREN_ASSERT(isValid());
     SIREN_ASSERT(stream != nullptr);
-    std::size_t numberOfBytes = read(stream->getBuffer(), stream->getBufferSize());
-    stream->commitBuffer(numberOfBytes);
+    // only connections which really stream grow their buffers, the others stay tiny and take
+    // whatever exceeds their free space from the spill buffer of the loop
+    stream->reserveBuffer(expectedReadSize_);
+    std::size_t bufferSize = stream->getBufferSize();
+    std::size_t spillBufferSize;
+    char *spillBuffer = loop_->getSpillBuffer(&spillBufferSize);
+    iovec vector[2] = {{stream->getBuffer(), bufferSize}, {spillBuffer, spillBufferSize}};
+    ssize_t numberOfBytes = loop_->readv(fd_, vector, 2);
+
+    if (numberOfBytes < 0) {
+        throw std::system_error(errno, std::system_category(), "readv() failed");
+    }
+
+    if (static_cast<std::size_t>(numberOfBytes) <= bufferSize) {
+        stream->commitBuffer(numberOfBytes);
+    } else {
+        stream->commitBuffer(bufferSize);
+        stream->write(spillBuffer, numberOfBytes - bufferSize);
+    }
+
+    // a burst must not pin a large reservation on every later read
+    expectedReadSize_ = std::min(std::max<std::size_t>(numberOfBytes, expectedReadSize_ / 2)
+                                 , MaxExpectedReadSize);
     return numberOfBytes;
 }
 
@@ -337,6 +526,44 @@ TCPSocket::write(Stream *stream)
 }
 
 
+std::size_t
+TCPSocket::read(SegmentedStream *stream)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(stream != nullptr);
+    iovec vector[16];
+    int vectorLength = stream->getBufferVector(vector, sizeof(vector) / sizeof(vector[0]));
+    ssize_t numberOfBytes = loop_->readv(fd_, vector, vectorLength);
+
+    if (numberOfBytes < 0) {
+        throw std::system_error(errno, std::system_category(), "readv() failed");
+    }
+
+    stream->commitBuffer(numberOfBytes);
+    return numberOfBytes;
+}
+
+
+std::size_t
+TCPSocket::write(SegmentedStream *stream)
+{
+    SIREN_ASSERT(isValid());
+    SIREN_ASSERT(stream != nullptr);
+    iovec vector[16];
+    msghdr message = {};
+    message.msg_iov = vector;
+    message.msg_iovlen = stream->getDataVector(vector, sizeof(vector) / sizeof(vector[0]));
+    ssize_t numberOfBytes = loop_->sendmsg(fd_, &message, MSG_NOSIGNAL);
+
+    if (numberOfBytes < 0) {
+        throw std::system_error(errno, std::system_category(), "sendmsg() failed");
+    }
+
+    stream->discardData(numberOfBytes);
+    return numberOfBytes;
+}
+
+
 void
 TCPSocket::closeRead()
 {
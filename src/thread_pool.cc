@@ -3,9 +3,15 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
+#include <ctime>
+#include <algorithm>
+#include <limits>
 #include <system_error>
 
+#include <linux/futex.h>
+#include <pthread.h>
 #include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "config.h"
@@ -13,20 +19,28 @@
 
 namespace siren {
 
+namespace {
+
+bool Futex(std::atomic<int> *, int, int, const timespec * = nullptr) noexcept;
+
+thread_local ThreadPoolTask *CurrentTask = nullptr;
+
+} // namespace
+
+
 ThreadPoolTask::~ThreadPoolTask()
 {
-    SIREN_ASSERT(state_.load(std::memory_order_relaxed) == State::Initial);
+    SIREN_ASSERT(state_ == State::Initial);
 }
 
 
 void
 ThreadPoolTask::check()
 {
-    SIREN_ASSERT(state_.load(std::memory_order_relaxed) == State::Completed);
+    SIREN_ASSERT(state_ == State::Completed);
 #ifdef SIREN_WITH_DEBUG
-    state_.store(State::Initial, std::memory_order_relaxed);
+    state_ = State::Initial;
 #endif
-    procedure_ = nullptr;
 
     if (exception_ != nullptr) {
         std::rethrow_exception(std::move(exception_));
@@ -34,7 +48,14 @@ ThreadPoolTask::check()
 }
 
 
-ThreadPool::ThreadPool(std::size_t numberOfThreads)
+ThreadPool::ThreadPool(std::size_t minNumberOfThreads, std::size_t maxNumberOfThreads
+                       , long idleTimeout, long maxQueueDelay)
+  : minNumberOfThreads_(minNumberOfThreads == 0
+                        ? std::max(std::thread::hardware_concurrency(), 1U)
+                        : minNumberOfThreads),
+    maxNumberOfThreads_(std::max(maxNumberOfThreads, minNumberOfThreads_)),
+    idleTimeout_(idleTimeout),
+    maxQueueDelay_(maxQueueDelay)
 {
     initialize();
 
@@ -42,11 +63,7 @@ ThreadPool::ThreadPool(std::size_t numberOfThreads)
         finalize();
     });
 
-    if (numberOfThreads == 0) {
-        numberOfThreads = std::thread::hardware_concurrency();
-    }
-
-    start(numberOfThreads);
+    start(minNumberOfThreads_);
     scopeGuard.dismiss();
 }
 
@@ -61,6 +78,40 @@ ThreadPool::~ThreadPool()
 void
 ThreadPool::initialize()
 {
+    constexpr std::size_t k = 1024;
+    cells_ = std::make_unique<Cell []>(k);
+    cellIndexMask_ = k - 1;
+
+    for (std::size_t i = 0; i < k; ++i) {
+        cells_[i].sequenceNumber.store(i, std::memory_order_relaxed);
+        cells_[i].task.store(nullptr, std::memory_order_relaxed);
+    }
+
+    enqueueCount_.store(0, std::memory_order_relaxed);
+    dequeueCount_.store(0, std::memory_order_relaxed);
+    overflowedTaskCount_.store(0, std::memory_order_relaxed);
+    futex_.store(0, std::memory_order_relaxed);
+    idleWorkerCount_.store(0, std::memory_order_relaxed);
+    isStopped_.store(false, std::memory_order_relaxed);
+    completedTaskStack_.store(nullptr, std::memory_order_relaxed);
+    threadCount_.store(0, std::memory_order_relaxed);
+    busyThreadCount_.store(0, std::memory_order_relaxed);
+    executedTaskCount_.store(0, std::memory_order_relaxed);
+    totalWaitTime_.store(0, std::memory_order_relaxed);
+    totalBusyTime_.store(0, std::memory_order_relaxed);
+    lastDequeueTime_.store(std::chrono::steady_clock::now().time_since_epoch().count()
+                           , std::memory_order_relaxed);
+
+    for (std::atomic<std::size_t> &waitTimeCount : waitTimeHistogram_) {
+        waitTimeCount.store(0, std::memory_order_relaxed);
+    }
+
+    // workers inherit the placement of the creating thread (typically a pinned loop thread)
+    // rather than that of whichever thread happens to spawn them later
+    if (sched_getaffinity(0, sizeof(cpuSet_), &cpuSet_) < 0) {
+        throw std::system_error(errno, std::system_category(), "sched_getaffinity() failed");
+    }
+
     eventFD_ = eventfd(0, 0);
 
     if (eventFD_ < 0) {
@@ -82,15 +133,23 @@ ThreadPool::finalize() noexcept
 void
 ThreadPool::start(std::size_t numberOfThreads)
 {
-    threads_.reserve(numberOfThreads);
-    threads_.emplace_back(&ThreadPool::worker, this);
-
     auto scopeGuard = MakeScopeGuard([&] () -> void {
         stop();
     });
 
-    while (--numberOfThreads >= 1) {
+    std::lock_guard<std::mutex> lockGuard(threadMutex_);
+    threads_.reserve(numberOfThreads);
+
+    while (numberOfThreads >= 1) {
         threads_.emplace_back(&ThreadPool::worker, this);
+        threadCount_.fetch_add(1, std::memory_order_relaxed);
+        --numberOfThreads;
+        int errorNumber = bindWorker(&threads_.back());
+
+        if (errorNumber != 0) {
+            throw std::system_error(errorNumber, std::system_category()
+                                    , "pthread_setaffinity_np() failed");
+        }
     }
 
     scopeGuard.dismiss();
@@ -101,8 +160,14 @@ void
 ThreadPool::stop() noexcept
 {
     noMoreWaitingTasks();
+    std::vector<std::thread> threads;
 
-    for (std::thread &thread : threads_) {
+    {
+        std::lock_guard<std::mutex> lockGuard(threadMutex_);
+        threads = std::move(threads_);
+    }
+
+    for (std::thread &thread : threads) {
         thread.join();
     }
 }
@@ -112,31 +177,28 @@ void
 ThreadPool::worker() noexcept
 {
     for (;;) {
-        ThreadPoolTask *task = removeWaitingTask();
+        Task *task = removeWaitingTask();
 
         if (task == nullptr) {
             return;
-        } else {
-            try {
-                task->procedure_();
-            } catch (...) {
-                task->exception_ = std::current_exception();
-            }
+        }
 
-            addCompletedTask(task);
-            task->state_.store(TaskState::Completed, std::memory_order_release);
+        executeTask(task);
 
-            for (;;) {
-                std::uint64_t dummy = 1;
+        if (!addCompletedTask(task)) {
+            continue;
+        }
 
-                if (write(eventFD_, &dummy, sizeof(dummy)) < 0) {
-                    if (errno != EINTR) {
-                        std::perror("write() failed");
-                        std::terminate();
-                    }
-                } else {
-                    break;
+        for (;;) {
+            std::uint64_t dummy = 1;
+
+            if (write(eventFD_, &dummy, sizeof(dummy)) < 0) {
+                if (errno != EINTR) {
+                    std::perror("write() failed");
+                    std::terminate();
                 }
+            } else {
+                break;
             }
         }
     }
@@ -144,51 +206,218 @@ ThreadPool::worker() noexcept
 
 
 void
-ThreadPool::removeTask(Task *task, bool *taskIsCompleted) noexcept
+ThreadPool::spawnWorker() noexcept
 {
-    SIREN_ASSERT(task != nullptr);
-    SIREN_ASSERT(taskIsCompleted != nullptr);
-    SIREN_ASSERT(task->state_.load(std::memory_order_relaxed) != TaskState::Initial);
+    std::unique_lock<std::mutex> uniqueLock(threadMutex_, std::try_to_lock);
+
+    if (!uniqueLock.owns_lock() || isStopped_.load(std::memory_order_relaxed)
+        || threadCount_.load(std::memory_order_relaxed) >= maxNumberOfThreads_) {
+        return;
+    }
+
+    for (std::thread::id threadID : retiredThreadIDs_) {
+        auto thread = std::find_if(threads_.begin(), threads_.end()
+                                   , [&] (const std::thread &thread) -> bool {
+            return thread.get_id() == threadID;
+        });
+
+        thread->join();
+        *thread = std::move(threads_.back());
+        threads_.pop_back();
+    }
+
+    retiredThreadIDs_.clear();
+
+    try {
+        threads_.emplace_back(&ThreadPool::worker, this);
+    } catch (...) {
+        // spawning is best-effort, the existing workers will drain the queue anyway
+        return;
+    }
+
+    threadCount_.fetch_add(1, std::memory_order_relaxed);
+    bindWorker(&threads_.back());
+}
+
+
+int
+ThreadPool::bindWorker(std::thread *thread) noexcept
+{
+    return pthread_setaffinity_np(thread->native_handle(), sizeof(cpuSet_), &cpuSet_);
+}
+
+
+bool
+ThreadPool::retireWorker() noexcept
+{
+    std::lock_guard<std::mutex> lockGuard(threadMutex_);
 
-    if (task->state_.load(std::memory_order_acquire) == TaskState::Uncompleted) {
-        *taskIsCompleted = false;
+    if (threadCount_.load(std::memory_order_relaxed) <= minNumberOfThreads_) {
+        return false;
+    }
+
+    try {
+        retiredThreadIDs_.push_back(std::this_thread::get_id());
+    } catch (...) {
+        return false;
+    }
+
+    threadCount_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+void
+ThreadPool::adjustNumberOfThreads(std::chrono::steady_clock::duration queueDelay) noexcept
+{
+    if (queueDelay > maxQueueDelay_
+        && threadCount_.load(std::memory_order_relaxed) < maxNumberOfThreads_
+        && idleWorkerCount_.load(std::memory_order_relaxed) == 0 && hasWaitingTasks()) {
+        spawnWorker();
+    }
+}
 
-        if (removeWaitingTask(task)) {
+
+void
+ThreadPool::recordWaitTime(std::chrono::steady_clock::duration waitTime) noexcept
+{
+    // bucket #i counts the wait times of [2^(i-1), 2^i) microseconds
+    constexpr std::size_t k = sizeof(waitTimeHistogram_) / sizeof(waitTimeHistogram_[0]);
+    auto x = static_cast<unsigned long long>(std::max<std::chrono::microseconds::rep>(
+        std::chrono::duration_cast<std::chrono::microseconds>(waitTime).count(), 0));
+    std::size_t i = x == 0 ? 0 : std::min<std::size_t>(64 - __builtin_clzll(x), k - 1);
+    waitTimeHistogram_[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void
+ThreadPool::executeTask(Task *task) noexcept
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration waitTime = startTime - task->enqueueTime_;
+    lastDequeueTime_.store(startTime.time_since_epoch().count(), std::memory_order_relaxed);
+    totalWaitTime_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waitTime)
+                             .count(), std::memory_order_relaxed);
+    recordWaitTime(waitTime);
+    busyThreadCount_.fetch_add(1, std::memory_order_relaxed);
+
+    if (maxNumberOfThreads_ > minNumberOfThreads_) {
+        adjustNumberOfThreads(waitTime);
+    }
+
+    CurrentTask = task;
+
+    try {
+        task->function_(task->argument_);
+    } catch (...) {
+        task->exception_ = std::current_exception();
+    }
+
+    CurrentTask = nullptr;
+    std::chrono::steady_clock::duration busyTime = std::chrono::steady_clock::now() - startTime;
+    totalBusyTime_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busyTime)
+                             .count(), std::memory_order_relaxed);
+    busyThreadCount_.fetch_sub(1, std::memory_order_relaxed);
+    executedTaskCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+bool
+ThreadPool::CurrentTaskIsCancelled() noexcept
+{
+    SIREN_ASSERT(CurrentTask != nullptr);
+    return CurrentTask->isCancelled_.load(std::memory_order_relaxed);
+}
+
+
+bool
+ThreadPool::removeTask(Task *task) noexcept
+{
+    SIREN_ASSERT(task != nullptr);
+    SIREN_ASSERT(task->state_ != TaskState::Initial);
+
+    if (task->state_ == TaskState::Uncompleted && removeWaitingTask(task)) {
 #ifdef SIREN_WITH_DEBUG
-            task->state_.store(TaskState::Initial, std::memory_order_relaxed);
+        task->state_ = TaskState::Initial;
 #endif
-            return;
-        } else {
-            while (task->state_.load(std::memory_order_acquire) == TaskState::Uncompleted) {
-                std::this_thread::yield();
-            }
-        }
+        return true;
+    } else {
+        task->isCancelled_.store(true, std::memory_order_relaxed);
+        return false;
     }
+}
 
-    *taskIsCompleted = true;
-    removeCompletedTask(task);
+
+void
+ThreadPool::getCPUAffinity(cpu_set_t *cpuSet) const noexcept
+{
+    SIREN_ASSERT(cpuSet != nullptr);
+    std::lock_guard<std::mutex> lockGuard(threadMutex_);
+    *cpuSet = cpuSet_;
+}
+
+
+void
+ThreadPool::setCPUAffinity(const cpu_set_t &cpuSet)
+{
+    std::lock_guard<std::mutex> lockGuard(threadMutex_);
+    cpu_set_t oldCPUSet = cpuSet_;
+    cpuSet_ = cpuSet;
+
+    for (std::thread &thread : threads_) {
+        int errorNumber = bindWorker(&thread);
+
+        // ESRCH: a retired worker which has already exited but not been joined yet
+        if (errorNumber != 0 && errorNumber != ESRCH) {
+            cpuSet_ = oldCPUSet;
+            throw std::system_error(errorNumber, std::system_category()
+                                    , "pthread_setaffinity_np() failed");
+        }
+    }
 }
 
 
 void
 ThreadPool::addWaitingTask(Task *task)
 {
-    std::lock_guard<std::mutex> lockGuard(mutexes_[0]);
-    waitingTaskList_.appendNode((task->isWaiting_ = true, task));
-    conditionVariable_.notify_one();
+    std::chrono::steady_clock::time_point enqueueTime = task->enqueueTime_;
+    task->isWaiting_ = false;
+
+    if (!enqueueTask(task)) {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        task->cell_ = nullptr;
+        overflowedTaskList_.appendNode((task->isWaiting_ = true, task));
+        overflowedTaskCount_.fetch_add(1, std::memory_order_release);
+    }
+
+    wakeWorkers(1);
+
+    if (maxNumberOfThreads_ > minNumberOfThreads_) {
+        std::chrono::steady_clock::time_point lastDequeueTime(std::chrono::steady_clock::duration(
+            lastDequeueTime_.load(std::memory_order_relaxed)));
+
+        adjustNumberOfThreads(enqueueTime - lastDequeueTime);
+    }
 }
 
 
 bool
 ThreadPool::removeWaitingTask(Task *task) noexcept
 {
-    std::unique_lock<std::mutex> uniqueLock(mutexes_[0]);
+    if (task->cell_ == nullptr) {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
 
-    if (task->isWaiting_) {
-        task->remove();
-        return true;
+        if (task->isWaiting_) {
+            (task->isWaiting_ = false, task)->remove();
+            overflowedTaskCount_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        } else {
+            return false;
+        }
     } else {
-        return false;
+        Task *expectedTask = task;
+        return task->cell_->task.compare_exchange_strong(expectedTask, nullptr
+                                                         , std::memory_order_relaxed);
     }
 }
 
@@ -196,46 +425,217 @@ ThreadPool::removeWaitingTask(Task *task) noexcept
 ThreadPoolTask *
 ThreadPool::removeWaitingTask() noexcept
 {
-    std::unique_lock<std::mutex> uniqueLock(mutexes_[0]);
+    for (;;) {
+        bool isStopped = isStopped_.load(std::memory_order_acquire);
+        Task *task = dequeueTask();
+
+        if (task != nullptr) {
+            return task;
+        }
 
-    while (waitingTaskList_.isEmpty()) {
-        conditionVariable_.wait(uniqueLock);
+        if (overflowedTaskCount_.load(std::memory_order_acquire) >= 1) {
+            std::lock_guard<std::mutex> lockGuard(mutex_);
+
+            if (!overflowedTaskList_.isEmpty()) {
+                task = static_cast<Task *>(overflowedTaskList_.getHead());
+                (task->isWaiting_ = false, task)->remove();
+                overflowedTaskCount_.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+
+        if (isStopped) {
+            return nullptr;
+        }
+
+        if (!waitForTasks()) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!hasWaitingTasks() && retireWorker()) {
+                return nullptr;
+            }
+        }
     }
+}
 
-    ListNode *listNode = waitingTaskList_.getTail();
 
-    if (listNode == &noListNode_) {
-        return nullptr;
-    } else {
-        Task *task = static_cast<ThreadPoolTask *>(listNode);
-        (task->isWaiting_ = false, task)->remove();
-        return task;
+bool
+ThreadPool::enqueueTask(Task *task) noexcept
+{
+    std::size_t position = enqueueCount_.load(std::memory_order_relaxed);
+    Cell *cell;
+
+    for (;;) {
+        cell = &cells_[position & cellIndexMask_];
+        std::size_t sequenceNumber = cell->sequenceNumber.load(std::memory_order_acquire);
+        auto difference = static_cast<std::ptrdiff_t>(sequenceNumber - position);
+
+        if (difference == 0) {
+            if (enqueueCount_.compare_exchange_weak(position, position + 1
+                                                    , std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = enqueueCount_.load(std::memory_order_relaxed);
+        }
     }
+
+    task->cell_ = cell;
+    cell->task.store(task, std::memory_order_relaxed);
+    cell->sequenceNumber.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+
+ThreadPoolTask *
+ThreadPool::dequeueTask() noexcept
+{
+    for (;;) {
+        std::size_t position = dequeueCount_.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        for (;;) {
+            cell = &cells_[position & cellIndexMask_];
+            std::size_t sequenceNumber = cell->sequenceNumber.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequenceNumber - (position + 1));
+
+            if (difference == 0) {
+                if (dequeueCount_.compare_exchange_weak(position, position + 1
+                                                        , std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return nullptr;
+            } else {
+                position = dequeueCount_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // a null task means the task has been cancelled by removeTask()
+        Task *task = cell->task.exchange(nullptr, std::memory_order_acquire);
+        cell->sequenceNumber.store(position + cellIndexMask_ + 1, std::memory_order_release);
+
+        if (task != nullptr) {
+            return task;
+        }
+    }
+}
+
+
+bool
+ThreadPool::hasWaitingTasks() const noexcept
+{
+    std::size_t position = dequeueCount_.load(std::memory_order_relaxed);
+    const Cell *cell = &cells_[position & cellIndexMask_];
+    return cell->sequenceNumber.load(std::memory_order_acquire) != position
+           || overflowedTaskCount_.load(std::memory_order_acquire) >= 1;
 }
 
 
 void
-ThreadPool::noMoreWaitingTasks()
+ThreadPool::wakeWorkers(int numberOfWorkers) noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (idleWorkerCount_.load(std::memory_order_relaxed) >= 1) {
+        futex_.fetch_add(1, std::memory_order_seq_cst);
+        Futex(&futex_, FUTEX_WAKE_PRIVATE, numberOfWorkers);
+    }
+}
+
+
+bool
+ThreadPool::waitForTasks() noexcept
 {
-    std::lock_guard<std::mutex> lockGuard(mutexes_[0]);
-    waitingTaskList_.prependNode(&noListNode_);
-    conditionVariable_.notify_all();
+    int futexValue = futex_.load(std::memory_order_seq_cst);
+    idleWorkerCount_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool tasksMayBeWaiting = true;
+
+    if (!hasWaitingTasks() && !isStopped_.load(std::memory_order_acquire)) {
+        if (maxNumberOfThreads_ > minNumberOfThreads_) {
+            timespec timeout;
+            timeout.tv_sec = idleTimeout_.count() / 1000;
+            timeout.tv_nsec = idleTimeout_.count() % 1000 * 1000000;
+            tasksMayBeWaiting = Futex(&futex_, FUTEX_WAIT_PRIVATE, futexValue, &timeout);
+        } else {
+            Futex(&futex_, FUTEX_WAIT_PRIVATE, futexValue);
+        }
+    }
+
+    idleWorkerCount_.fetch_sub(1, std::memory_order_seq_cst);
+    return tasksMayBeWaiting;
 }
 
 
 void
-ThreadPool::addCompletedTask(Task *task)
+ThreadPool::noMoreWaitingTasks() noexcept
 {
-    std::unique_lock<std::mutex> uniqueLock(mutexes_[1]);
-    completedTaskList_.appendNode(task);
+    isStopped_.store(true, std::memory_order_release);
+    wakeWorkers(std::numeric_limits<int>::max());
+}
+
+
+bool
+ThreadPool::addCompletedTask(Task *task) noexcept
+{
+    Task *nextCompletedTask = completedTaskStack_.load(std::memory_order_relaxed);
+
+    do {
+        task->nextCompleted_ = nextCompletedTask;
+    } while (!completedTaskStack_.compare_exchange_weak(nextCompletedTask, task
+                                                       , std::memory_order_release
+                                                       , std::memory_order_relaxed));
+
+    // only the first completion after the stack was drained has to signal the event fd,
+    // the others are picked up by the same removeCompletedTasks() call
+    return nextCompletedTask == nullptr;
 }
 
 
 void
-ThreadPool::removeCompletedTask(Task *task) noexcept
+ThreadPool::flushCompletedTasks() noexcept
+{
+    Task *task = completedTaskStack_.exchange(nullptr, std::memory_order_acquire);
+
+    if (task == nullptr) {
+        return;
+    }
+
+    List list;
+
+    do {
+        task->state_ = TaskState::Completed;
+        list.prependNode(task);
+        task = task->nextCompleted_;
+    } while (task != nullptr);
+
+    list.append(&completedTaskList_);
+}
+
+
+namespace {
+
+bool
+Futex(std::atomic<int> *futex, int operation, int value, const timespec *timeout) noexcept
 {
-    std::unique_lock<std::mutex> uniqueLock(mutexes_[1]);
-    task->remove();
+    if (syscall(SYS_futex, reinterpret_cast<int *>(futex), operation, value, timeout, nullptr
+                , 0) < 0) {
+        if (errno == ETIMEDOUT) {
+            return false;
+        }
+
+        if (errno != EAGAIN && errno != EINTR) {
+            std::perror("futex() failed");
+            std::terminate();
+        }
+    }
+
+    return true;
 }
 
+} // namespace
+
 } // namespace siren
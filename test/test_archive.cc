@@ -1,3 +1,11 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <vector>
+
 #include "archive.h"
 #include "stream.h"
 #include "test.h"
@@ -103,4 +111,308 @@ SIREN_TEST("Serialize/Deserialize variable-length integers")
     SIREN_TEST_ASSERT(t == -6);
 }
 
+
+SIREN_TEST("Deserialize views into streams")
+{
+    Stream s;
+    Archive a(&s);
+    std::vector<int> in = {123, -234, 456};
+    a << std::string("hello") << in << 'x';
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    StringView sv;
+    ArrayView<int> av;
+    char c;
+    a >> sv >> av >> c;
+    SIREN_TEST_ASSERT(sv.getData() == static_cast<char *>(s.getData(1)));
+    SIREN_TEST_ASSERT(sv.toString() == "hello");
+    SIREN_TEST_ASSERT(av.getLength() == 3 && av[1] == -234);
+    SIREN_TEST_ASSERT(av.toVector() == in);
+    SIREN_TEST_ASSERT(c == 'x');
+    Stream s2;
+    Archive a2(&s2);
+    a2 << sv << av;
+    s2.commitBuffer(a2.getNumberOfPreWrittenBytes());
+    s.discardData(a.getNumberOfPreReadBytes());
+    std::string x;
+    std::vector<int> y;
+    a2 >> x >> y;
+    SIREN_TEST_ASSERT(x == "hello" && y == in);
+}
+
+
+SIREN_TEST("Reject hostile view lengths")
+{
+    Stream s;
+    Archive a(&s);
+    a << VLI<std::uintmax_t>(std::numeric_limits<std::uintmax_t>::max());
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    StringView sv;
+    ArrayView<std::uint32_t> av;
+
+    try {
+        a >> sv;
+        SIREN_TEST_ASSERT(false);
+    } catch (const EndOfStream &) {
+    }
+
+    Archive a2(&s);
+
+    try {
+        a2 >> av;
+        SIREN_TEST_ASSERT(false);
+    } catch (const std::system_error &e) {
+        SIREN_TEST_ASSERT(e.code().value() == EBADMSG);
+    }
+
+    Stream s2;
+    Archive a3(&s2);
+    a3 << VLI<std::uintmax_t>(std::numeric_limits<std::uintmax_t>::max() / 2 + 2);
+    s2.commitBuffer(a3.getNumberOfPreWrittenBytes());
+
+    try {
+        a3 >> av;
+        SIREN_TEST_ASSERT(false);
+    } catch (const std::system_error &e) {
+        SIREN_TEST_ASSERT(e.code().value() == EBADMSG);
+    }
+}
+
+
+SIREN_TEST("Serialize/Deserialize vectors of fixed-width numbers in bulk")
+{
+    Stream s;
+    Archive a(&s);
+    std::vector<std::uint32_t> in1(1000);
+    double in2[3] = {1.5, -2.25, 1e100};
+
+    for (std::size_t i = 0; i < in1.size(); ++i) {
+        in1[i] = i * 0x01020304;
+    }
+
+    a << in1 << in2;
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    SIREN_TEST_ASSERT(s.getDataSize() == 2 + 4 * in1.size() + sizeof(in2));
+    std::vector<std::uint32_t> out1;
+    VLI<std::size_t> n;
+    std::uint32_t x;
+    double out2[3];
+    a >> n >> x;
+    SIREN_TEST_ASSERT(n == in1.size() && x == in1[0]);
+    a = Archive(&s);
+    a >> out1 >> out2;
+    s.discardData(a.getNumberOfPreReadBytes());
+    SIREN_TEST_ASSERT(out1 == in1);
+
+    for (int i = 0; i < 3; ++i) {
+        SIREN_TEST_ASSERT(out2[i] == in2[i]);
+    }
+}
+
+
+SIREN_TEST("Serialize/Deserialize variable-length integers in batch")
+{
+    std::vector<VLI<long>> in;
+
+    for (int i = 0; i < 64; ++i) {
+        in.push_back(1L << i);
+        in.push_back((1L << i) - 1);
+        in.push_back(-(1L << i));
+        in.push_back(-(1L << i) - 1);
+    }
+
+    Stream s1;
+    Archive a1(&s1);
+    Stream s2;
+    Archive a2(&s2);
+    a1 << in;
+    a2 << VLI<std::size_t>(in.size());
+
+    for (const VLI<long> &x : in) {
+        a2 << x;
+    }
+
+    s1.commitBuffer(a1.getNumberOfPreWrittenBytes());
+    s2.commitBuffer(a2.getNumberOfPreWrittenBytes());
+    SIREN_TEST_ASSERT(s1.getDataSize() == s2.getDataSize());
+    SIREN_TEST_ASSERT(std::memcmp(s1.getData(), s2.getData(), s1.getDataSize()) == 0);
+    std::vector<VLI<long>> out;
+    a1 >> out;
+    s1.discardData(a1.getNumberOfPreReadBytes());
+    SIREN_TEST_ASSERT(s1.getDataSize() == 0);
+    SIREN_TEST_ASSERT(out.size() == in.size());
+    VLI<std::size_t> n;
+    a2 >> n;
+    SIREN_TEST_ASSERT(n == in.size());
+
+    for (std::size_t i = 0; i < in.size(); ++i) {
+        SIREN_TEST_ASSERT(out[i] == in[i]);
+        VLI<long> x;
+        a2 >> x;
+        SIREN_TEST_ASSERT(x == in[i]);
+    }
+}
+
+
+SIREN_TEST("Serialize structures at once")
+{
+    struct Inner {
+        std::string s;
+        std::vector<VLI<int>> v;
+
+        SIREN_SERDES(s, v)
+    };
+
+    struct Outer {
+        int i;
+        std::vector<Inner> v;
+        double d[2];
+
+        SIREN_SERDES(i, v, d)
+    };
+
+    Outer input{-1, {}, {1.0, 2.0}};
+
+    for (int i = 0; i < 100; ++i) {
+        input.v.push_back(Inner{std::string(i, 'x'), {i, -i, i << 20}});
+    }
+
+    Stream s1;
+    Archive a1(&s1);
+    a1 << input;
+    s1.commitBuffer(a1.getNumberOfPreWrittenBytes());
+    Stream s2;
+    Archive a2(&s2);
+    std::size_t n = a2.measure(input);
+    SIREN_TEST_ASSERT(n == s1.getDataSize());
+    SIREN_TEST_ASSERT(a2.getNumberOfPreWrittenBytes() == 0);
+    a2.serializeAtOnce(input);
+    SIREN_TEST_ASSERT(a2.getNumberOfPreWrittenBytes() == n);
+    s2.commitBuffer(a2.getNumberOfPreWrittenBytes());
+    SIREN_TEST_ASSERT(std::memcmp(s1.getData(), s2.getData(), n) == 0);
+    Outer output;
+    a2 >> output;
+    SIREN_TEST_ASSERT(output.i == -1 && output.v.size() == 100 && output.v[99].v[2] == 99 << 20);
+}
+
+
+SIREN_TEST("Serialize/Deserialize tagged structures across versions")
+{
+    struct Inner {
+        std::string s;
+
+        SIREN_SERDES(s)
+    };
+
+    struct Version1 {
+        int i = 0;
+        std::string s;
+
+        SIREN_SERDES(i, s)
+    };
+
+    struct Version2 {
+        int i = 0;
+        std::string s;
+        std::vector<Inner> v;
+        VLI<long> l = 0;
+
+        SIREN_SERDES(i, s, v, l)
+    };
+
+    Version2 input{-1, "hello", {Inner{"a"}, Inner{"b"}}, 1L << 40};
+    Stream s;
+    Archive a(&s);
+    a.setTagged(true);
+    std::size_t n = a.measure(input);
+    a << input;
+    SIREN_TEST_ASSERT(a.getNumberOfPreWrittenBytes() == n);
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    Version1 output1;
+    a >> output1;
+    SIREN_TEST_ASSERT(a.getNumberOfPreReadBytes() == n);
+    SIREN_TEST_ASSERT(output1.i == -1 && output1.s == "hello");
+    s.discardData(a.getNumberOfPreReadBytes());
+    a = Archive(&s);
+    a.setTagged(true);
+    a << output1;
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    Version2 output2;
+    output2.l = 7;
+    a >> output2;
+    s.discardData(a.getNumberOfPreReadBytes());
+    SIREN_TEST_ASSERT(s.getDataSize() == 0);
+    SIREN_TEST_ASSERT(output2.i == -1 && output2.s == "hello");
+    SIREN_TEST_ASSERT(output2.v.empty() && output2.l == 7);
+    a = Archive(&s);
+    a.setTagged(true);
+    a << input;
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    a >> output2;
+    SIREN_TEST_ASSERT(output2.v.size() == 2 && output2.v[1].s == "b" && output2.l == 1L << 40);
+    s.discardData(a.getNumberOfPreReadBytes());
+    a = Archive(&s);
+    a.setTagged(true);
+    a.beginChecksum();
+    a << input;
+    a.serializeChecksum();
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    // the older reader skips the blocks of the newer fields, block sizes included
+    a >> output1;
+    a.deserializeChecksum();
+    SIREN_TEST_ASSERT(a.getNumberOfPreReadBytes() == s.getDataSize());
+    s.discardData(a.getNumberOfPreReadBytes());
+    a = Archive(&s);
+    a.setTagged(true);
+    // field number 2^32 would be truncated to the end of the structure
+    a << VLI<std::uint64_t>(std::uint64_t(1) << 35);
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    int e = 0;
+
+    try {
+        a >> output1;
+    } catch (const std::system_error &exception) {
+        e = exception.code().value();
+    }
+
+    SIREN_TEST_ASSERT(e == EBADMSG);
+}
+
+
+SIREN_TEST("Serialize/Deserialize checksums")
+{
+    Stream s;
+    Archive a(&s);
+    a.beginChecksum();
+    a.serializeBytes("123456789", 9);
+    a.serializeChecksum();
+    a << std::string(1000, 'x');
+    a.serializeChecksum();
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    auto c = static_cast<const unsigned char *>(s.getData(9));
+    // the CRC32C check value
+    SIREN_TEST_ASSERT((c[0] | c[1] << 8 | c[2] << 16 | std::uint32_t(c[3]) << 24) == 0xE3069283);
+    char x[9];
+    std::string y;
+    a.deserializeBytes(x, 9);
+    a.deserializeChecksum();
+    a >> y;
+    a.deserializeChecksum();
+    SIREN_TEST_ASSERT(a.getNumberOfPreReadBytes() == s.getDataSize());
+    static_cast<char *>(s.getData())[9 + 4 + 2] ^= 1;
+    a = Archive(&s);
+    a.beginChecksum();
+    a.deserializeBytes(x, 9);
+    a.deserializeChecksum();
+    a >> y;
+    int e = 0;
+
+    try {
+        a.deserializeChecksum();
+    } catch (const std::system_error &exception) {
+        e = exception.code().value();
+    }
+
+    SIREN_TEST_ASSERT(e == EBADMSG);
+}
+
 }
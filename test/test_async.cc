@@ -1,5 +1,9 @@
 #include <cerrno>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <string>
+#include <vector>
 
 #include "async.h"
 #include "loop.h"
@@ -55,10 +59,10 @@ SIREN_TEST("Execute async task")
 
     loop.createFiber([&] () {
         loop.interruptFiber(f);
-        SIREN_TEST_ASSERT(x == 1 || x == 2);
     });
 
     loop.run();
+    SIREN_TEST_ASSERT(x == 1 || x == 2);
 }
 
 }
@@ -87,3 +91,213 @@ SIREN_TEST("Do async calls")
 
     loop.run();
 }
+
+
+SIREN_TEST("Interrupt running async tasks without stalling loop")
+{
+    Loop loop;
+    Async async(&loop, 1);
+    int x = 0;
+
+    void *f = loop.createFiber([&] () {
+        try {
+            async.executeTask([&] () {
+                usleep(300 * 1000);
+            });
+
+            x = 1;
+        } catch (FiberInterruption) {
+            x = 2;
+        }
+    });
+
+    loop.createFiber([&] () {
+        loop.usleep(100 * 1000);
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        loop.interruptFiber(f);
+        loop.usleep(10 * 1000);
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        SIREN_TEST_ASSERT(t2 - t1 < std::chrono::milliseconds(100));
+        SIREN_TEST_ASSERT(x == 0);
+    });
+
+    loop.run();
+    SIREN_TEST_ASSERT(x == 1);
+}
+
+
+SIREN_TEST("Submit async tasks and wait for them together")
+{
+    Loop loop;
+    Async async(&loop, 4);
+
+    loop.createFiber([&] () {
+        std::vector<AsyncFuture<int>> fs;
+
+        for (int i = 0; i < 10; ++i) {
+            fs.push_back(async.submit([] (int x) -> int {
+                usleep(10 * 1000);
+                return x * x;
+            }, i));
+        }
+
+        async.whenAll(fs);
+
+        for (int i = 0; i < 10; ++i) {
+            SIREN_TEST_ASSERT(fs[i].isReady());
+            SIREN_TEST_ASSERT(fs[i].get() == i * i);
+        }
+
+        std::vector<AsyncFuture<std::string>> gs;
+
+        gs.push_back(async.submit([] () -> std::string {
+            usleep(300 * 1000);
+            return "slow";
+        }));
+
+        gs.push_back(async.submit([] () -> std::string {
+            return std::string(100, 'x');
+        }));
+
+        std::size_t i = async.whenAny(gs);
+        SIREN_TEST_ASSERT(i == 1);
+        SIREN_TEST_ASSERT(gs[1].get() == std::string(100, 'x'));
+
+        AsyncFuture<void> h = async.submit([] () -> void {
+            throw 239;
+        });
+
+        int f = false;
+
+        try {
+            h.get();
+        } catch (int s) {
+            f = true;
+            SIREN_TEST_ASSERT(s == 239);
+        }
+
+        SIREN_TEST_ASSERT(f);
+    });
+
+    loop.run();
+}
+
+
+SIREN_TEST("Call async functions in separate lanes")
+{
+    Loop loop;
+    Async async(&loop, 1);
+    async.addLane(AsyncLane::Disk, 1);
+    const Async &constAsync = async;
+    SIREN_TEST_ASSERT(constAsync.getThreadPool(AsyncLane::DNS) == constAsync.getThreadPool());
+    SIREN_TEST_ASSERT(constAsync.getThreadPool(AsyncLane::Disk) != constAsync.getThreadPool());
+
+    loop.createFiber([&] () {
+        async.callFunction(AsyncLane::Disk, usleep, 300 * 1000);
+    });
+
+    loop.createFiber([&] () {
+        loop.usleep(10 * 1000);
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        int a = async.callFunction(AsyncLane::DNS, [] (int x) -> int { return x + 1; }, 99);
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        SIREN_TEST_ASSERT(a == 100);
+        SIREN_TEST_ASSERT(t2 - t1 < std::chrono::milliseconds(100));
+    });
+
+    loop.run();
+    std::size_t n = 0;
+
+    for (std::size_t i = 0; i < 32; ++i) {
+        n += constAsync.getThreadPool(AsyncLane::Disk)->getWaitTimeHistogram(i);
+    }
+
+    SIREN_TEST_ASSERT(n == 1);
+}
+
+
+SIREN_TEST("Run parallel-for and parallel-reduce on async workers")
+{
+    Loop loop;
+    Async async(&loop, 4);
+
+    loop.createFiber([&] () {
+        std::vector<int> v(10000, 0);
+
+        async.parallelFor(0, v.size(), 64, [&] (std::size_t i, std::size_t j) -> void {
+            for (; i < j; ++i) {
+                v[i] += static_cast<int>(i);
+            }
+        });
+
+        for (std::size_t i = 0; i < v.size(); ++i) {
+            SIREN_TEST_ASSERT(v[i] == static_cast<int>(i));
+        }
+
+        long s = async.parallelReduce(AsyncLane::CPU, 1, 10001, 100, 0L
+                                      , [] (std::size_t i, std::size_t j) -> long {
+            long s = 0;
+
+            for (; i < j; ++i) {
+                s += i;
+            }
+
+            return s;
+        }, [] (long x, long y) -> long {
+            return x + y;
+        });
+
+        SIREN_TEST_ASSERT(s == 50005000L);
+        SIREN_TEST_ASSERT(async.parallelReduce(7, 7, 1, 3, [] (std::size_t, std::size_t) -> int {
+            return 0;
+        }, [] (int x, int y) -> int {
+            return x + y;
+        }) == 3);
+
+        bool ok = false;
+
+        try {
+            async.parallelFor(0, 1000, 1, [&] (std::size_t i, std::size_t) -> void {
+                if (i == 500) {
+                    throw std::string("foo");
+                }
+            });
+        } catch (const std::string &e) {
+            ok = e == "foo";
+        }
+
+        SIREN_TEST_ASSERT(ok);
+        SIREN_TEST_ASSERT(async.getThreadPool()->getNumberOfWaitingTasks() == 0);
+    });
+
+    loop.run();
+}
+
+
+SIREN_TEST("Interrupt parallel-for on async workers")
+{
+    Loop loop;
+    Async async(&loop, 2);
+    std::atomic<int> n(0);
+
+    void *f = loop.createFiber([&] () {
+        try {
+            async.parallelFor(0, 100, 1, [&] (std::size_t, std::size_t) -> void {
+                ++n;
+                usleep(10 * 1000);
+            });
+        } catch (FiberInterruption) {
+            SIREN_TEST_ASSERT(n.load() < 100);
+            return;
+        }
+
+        SIREN_TEST_ASSERT(false);
+    });
+
+    loop.createFiber([&] () {
+        loop.usleep(50 * 1000);
+        loop.interruptFiber(f);
+    });
+
+    loop.run();
+}
@@ -57,4 +57,37 @@ SIREN_TEST("Move buffers")
     }
 }
 
+
+SIREN_TEST("Use pooled buffers")
+{
+    Buffer<int> b1(BufferStorage::Pooled);
+    b1.setLength(10);
+
+    for (int i = 0; i < 10; ++i) {
+        b1[i] = i;
+    }
+
+    b1.setLength(100000);
+    SIREN_TEST_ASSERT(b1.getLength() >= 100000);
+
+    for (int i = 0; i < 10; ++i) {
+        SIREN_TEST_ASSERT(b1[i] == i);
+    }
+
+    b1.shrinkLength(10);
+    SIREN_TEST_ASSERT(b1.getLength() >= 10 && b1.getLength() < 100000);
+
+    for (int i = 0; i < 10; ++i) {
+        SIREN_TEST_ASSERT(b1[i] == i);
+    }
+
+    int *p = b1;
+    Buffer<int> b2 = std::move(b1);
+    b2.reset();
+    Buffer<int> b3(BufferStorage::Pooled);
+    b3.setLength(10);
+    // the freed block is handed out again
+    SIREN_TEST_ASSERT(b3 == p);
+}
+
 }
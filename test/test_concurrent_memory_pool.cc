@@ -0,0 +1,148 @@
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "concurrent_memory_pool.h"
+#include "test.h"
+
+
+namespace {
+
+using namespace siren;
+
+
+SIREN_TEST("Allocate/Free concurrent memory blocks")
+{
+    for (std::size_t i = alignof(std::max_align_t) - 1, n = 1; n <= alignof(std::max_align_t)
+         ; i += 2, n *= 2) {
+        ConcurrentMemoryPool cmp(n, sizeof(void *) + i);
+        std::vector<void *> ps;
+
+        for (int j = 0; j < 1024; ++j) {
+            auto p = static_cast<char *>(cmp.allocateBlock());
+            SIREN_TEST_ASSERT(p != nullptr);
+            SIREN_TEST_ASSERT(reinterpret_cast<std::uintptr_t>(p) % n == 0);
+            std::fill(p, p + sizeof(void *) + i, j);
+            ps.push_back(p);
+        }
+
+        for (void *p : ps) {
+            cmp.freeBlock(p);
+        }
+
+        for (int j = 0; j < 1024; ++j) {
+            void *p = cmp.allocateBlock();
+            SIREN_TEST_ASSERT(std::find(ps.begin(), ps.end(), p) != ps.end());
+        }
+    }
+}
+
+
+SIREN_TEST("Free concurrent memory blocks on other threads")
+{
+    ConcurrentMemoryPool cmp(alignof(std::size_t), sizeof(std::size_t));
+    std::atomic<void *> slots[64];
+    const std::size_t n = 200000;
+
+    for (std::atomic<void *> &slot : slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // the consumer frees remotely while the owner keeps allocating from the same cache
+    std::thread t([&] () -> void {
+        for (std::size_t i = 0; i < n; ++i) {
+            std::atomic<void *> &slot = slots[i % 64];
+            void *p;
+
+            while ((p = slot.exchange(nullptr, std::memory_order_acquire)) == nullptr) {
+                std::this_thread::yield();
+            }
+
+            SIREN_TEST_ASSERT(*static_cast<std::size_t *>(p) == i);
+            cmp.freeBlock(p);
+        }
+    });
+
+    std::vector<void *> ps;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        auto p = static_cast<std::size_t *>(cmp.allocateBlock());
+        *p = i;
+        std::atomic<void *> &slot = slots[i % 64];
+
+        while (slot.load(std::memory_order_relaxed) != nullptr) {
+            std::this_thread::yield();
+        }
+
+        slot.store(p, std::memory_order_release);
+        ps.push_back(p);
+    }
+
+    t.join();
+    std::sort(ps.begin(), ps.end());
+    // blocks freed remotely come back to the owning thread, so few distinct ones are needed
+    SIREN_TEST_ASSERT(std::unique(ps.begin(), ps.end()) - ps.begin() < 4096);
+}
+
+
+SIREN_TEST("Move free concurrent memory blocks between threads")
+{
+    ConcurrentMemoryPool cmp(alignof(int), sizeof(int));
+    // with a cache of its own, this thread cannot just adopt the one of the exiting thread
+    void *q = cmp.allocateBlock();
+    std::vector<void *> ps;
+    std::atomic<int> state(0);
+
+    // nearly all of what a live thread frees goes to the depot, and another thread reuses it
+    std::thread t([&] () -> void {
+        for (int i = 0; i < 10000; ++i) {
+            ps.push_back(cmp.allocateBlock());
+        }
+
+        for (void *p : ps) {
+            cmp.freeBlock(p);
+        }
+
+        state.store(1);
+
+        while (state.load() != 2) {
+            std::this_thread::yield();
+        }
+    });
+
+    while (state.load() != 1) {
+        std::this_thread::yield();
+    }
+
+    std::sort(ps.begin(), ps.end());
+    std::size_t m = 0;
+
+    for (int i = 0; i < 10000; ++i) {
+        m += std::binary_search(ps.begin(), ps.end(), cmp.allocateBlock());
+    }
+
+    state.store(2);
+    t.join();
+    SIREN_TEST_ASSERT(m >= 9000);
+    void *p;
+
+    // the cache of an exited thread is adopted with the blocks other threads freed to it
+    std::thread t2([&] () -> void {
+        p = cmp.allocateBlock();
+    });
+
+    t2.join();
+    cmp.freeBlock(p);
+
+    std::thread t3([&] () -> void {
+        SIREN_TEST_ASSERT(cmp.allocateBlock() == p);
+    });
+
+    t3.join();
+    cmp.freeBlock(q);
+}
+
+}
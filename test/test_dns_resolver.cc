@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "dns_resolver.h"
+#include "ip_endpoint.h"
+#include "loop.h"
+#include "test.h"
+
+
+namespace {
+
+using namespace siren;
+
+
+int
+StartNameServer(Loop *loop, std::uint16_t *portNumber)
+{
+    int fd = loop->socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in name;
+    std::memset(&name, 0, sizeof(name));
+    name.sin_family = AF_INET;
+    name.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    SIREN_TEST_ASSERT(bind(fd, reinterpret_cast<sockaddr *>(&name), sizeof(name)) == 0);
+    socklen_t nameSize = sizeof(name);
+    SIREN_TEST_ASSERT(getsockname(fd, reinterpret_cast<sockaddr *>(&name), &nameSize) == 0);
+    *portNumber = ntohs(name.sin_port);
+    return fd;
+}
+
+
+void
+ServeNames(Loop *loop, int fd, int *numberOfQueries)
+{
+    for (;;) {
+        unsigned char message[512];
+        sockaddr_in name;
+        socklen_t nameSize = sizeof(name);
+        ssize_t n = loop->recvfrom(fd, message, sizeof(message), 0
+                                   , reinterpret_cast<sockaddr *>(&name), &nameSize);
+        SIREN_TEST_ASSERT(n >= 12);
+        ++*numberOfQueries;
+        std::string hostName;
+
+        for (ssize_t i = 12; message[i] != 0; i += 1 + message[i]) {
+            hostName.append(reinterpret_cast<char *>(&message[i + 1]), message[i]).append(".");
+        }
+
+        // answer after a while, so that concurrent lookups overlap
+        loop->usleep(20 * 1000);
+        message[2] = 0x81;
+
+        if (hostName == "bad.test.") {
+            message[3] = 0x83;
+        } else {
+            static const unsigned char answer[] = {
+                0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+                0x00, 0x04, 10, 0, 0, 1,
+            };
+
+            message[3] = 0x80;
+            message[7] = 1;
+            std::memcpy(&message[n], answer, sizeof(answer));
+            // ttl
+            message[n + 9] = hostName == "short.test." ? 0 : 60;
+            n += sizeof(answer);
+        }
+
+        loop->sendto(fd, message, n, 0, reinterpret_cast<sockaddr *>(&name), nameSize);
+    }
+}
+
+
+SIREN_TEST("Resolve and cache names with a name server")
+{
+    Loop loop;
+    std::uint16_t portNumber;
+    int fd = StartNameServer(&loop, &portNumber);
+    int n = 0;
+    void *f = loop.createFiber(std::bind(ServeNames, &loop, fd, &n), 0, true);
+    DNSResolver dnsResolver(&loop);
+    dnsResolver.setNameServer(IPEndpoint((127 << 24) | 1, portNumber));
+    int k = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        loop.createFiber([&] () -> void {
+            IPEndpoint ipe(&dnsResolver, "www.example.test", 80);
+            SIREN_TEST_ASSERT(ipe.address == ((10 << 24) | 1));
+            SIREN_TEST_ASSERT(ipe.portNumber == 80);
+            ++k;
+        });
+    }
+
+    loop.createFiber([&] () -> void {
+        loop.usleep(100 * 1000);
+        SIREN_TEST_ASSERT(k == 3);
+        SIREN_TEST_ASSERT(n == 1);
+        SIREN_TEST_ASSERT(dnsResolver.resolveName("www.example.test") == ((10 << 24) | 1));
+        SIREN_TEST_ASSERT(n == 1);
+
+        for (int i = 0; i < 2; ++i) {
+            try {
+                dnsResolver.resolveName("bad.test");
+                SIREN_TEST_ASSERT(false);
+            } catch (const GAIError &gaiError) {
+                SIREN_TEST_ASSERT(gaiError.getCode() == EAI_NONAME);
+            }
+        }
+
+        SIREN_TEST_ASSERT(n == 2);
+        dnsResolver.resolveName("short.test");
+        dnsResolver.resolveName("short.test");
+        SIREN_TEST_ASSERT(n == 4);
+        SIREN_TEST_ASSERT(dnsResolver.resolveName("192.168.0.1") == 0xC0A80001);
+        SIREN_TEST_ASSERT(n == 4);
+        SIREN_TEST_ASSERT(dnsResolver.resolveName("localhost") == ((127 << 24) | 1));
+        SIREN_TEST_ASSERT(n == 4);
+        SIREN_TEST_ASSERT(dnsResolver.getNumberOfCachedNames() == 4);
+        loop.interruptFiber(f);
+    });
+
+    loop.run();
+    loop.close(fd);
+}
+
+}
@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "archive.h"
+#include "framed_connection.h"
+#include "ip_endpoint.h"
+#include "loop.h"
+#include "tcp_socket.h"
+#include "test.h"
+
+
+namespace {
+
+using namespace siren;
+
+
+SIREN_TEST("Exchange framed requests and responses")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    int n = 0;
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs = ss.accept();
+        FramedConnection fc(&cs, FramePrefix::Fixed32);
+
+        while (fc.readFrames([&] (Archive *archive) -> void {
+            std::string request;
+            *archive >> request;
+            fc.writeFrame(request + "!");
+        }) >= 1) {
+            fc.flush();
+        }
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs(&l);
+        cs.connect(le);
+        FramedConnection fc(&cs, FramePrefix::Fixed32);
+
+        for (int i = 0; i < 100; ++i) {
+            fc.writeFrame(std::string(i * 100, 'a' + i % 26));
+        }
+
+        fc.flush();
+
+        while (n < 100 && fc.readFrames([&] (Archive *archive) -> void {
+            std::string response;
+            *archive >> response;
+            SIREN_TEST_ASSERT(response == std::string(n * 100, 'a' + n % 26) + "!");
+            ++n;
+        }) >= 1);
+
+        cs.closeWrite();
+    }, 16 * 1024);
+
+    l.run();
+    SIREN_TEST_ASSERT(n == 100);
+}
+
+
+SIREN_TEST("Reject oversized frames")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    int e = 0;
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs = ss.accept();
+        FramedConnection fc(&cs, FramePrefix::VLI, 100);
+
+        try {
+            fc.readFrames([&] (Archive *) -> void {});
+        } catch (const std::system_error &exception) {
+            e = exception.code().value();
+        }
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs(&l);
+        cs.connect(le);
+        FramedConnection fc(&cs);
+        fc.writeFrame(std::string(1000, 'x'));
+        fc.flush();
+        cs.closeWrite();
+    }, 16 * 1024);
+
+    l.run();
+    SIREN_TEST_ASSERT(e == EMSGSIZE);
+}
+
+
+SIREN_TEST("Reject frames read past their ends")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    int e = 0;
+    std::string x;
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs = ss.accept();
+        FramedConnection fc(&cs);
+
+        try {
+            fc.readFrames([&] (Archive *archive) -> void {
+                std::uint32_t y;
+                *archive >> y;
+            });
+        } catch (const std::system_error &exception) {
+            e = exception.code().value();
+        }
+
+        fc.readFrames([&] (Archive *archive) -> void {
+            *archive >> x;
+        });
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs(&l);
+        cs.connect(le);
+        FramedConnection fc(&cs);
+        fc.writeFrame(std::uint8_t(1));
+        fc.writeFrame(std::string("hello"));
+        fc.flush();
+        cs.closeWrite();
+    }, 16 * 1024);
+
+    l.run();
+    SIREN_TEST_ASSERT(e == EBADMSG);
+    SIREN_TEST_ASSERT(x == "hello");
+}
+
+
+SIREN_TEST("Discard frames whose callbacks throw")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    bool f = false;
+    std::string x;
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs = ss.accept();
+        FramedConnection fc(&cs);
+
+        try {
+            fc.readFrames([&] (Archive *) -> void {
+                throw std::runtime_error("bad frame");
+            });
+        } catch (const std::runtime_error &) {
+            f = true;
+        }
+
+        fc.readFrames([&] (Archive *archive) -> void {
+            *archive >> x;
+        });
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs(&l);
+        cs.connect(le);
+        FramedConnection fc(&cs);
+        fc.writeFrame(std::string("world"));
+        fc.writeFrame(std::string("hello"));
+        fc.flush();
+        cs.closeWrite();
+    }, 16 * 1024);
+
+    l.run();
+    SIREN_TEST_ASSERT(f);
+    SIREN_TEST_ASSERT(x == "hello");
+}
+
+}
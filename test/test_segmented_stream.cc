@@ -0,0 +1,62 @@
+#include <cstring>
+#include <string>
+
+#include "segmented_stream.h"
+#include "test.h"
+
+
+namespace {
+
+using namespace siren;
+
+
+SIREN_TEST("Write and read segmented streams")
+{
+    SegmentedStream s(64);
+    std::string d;
+
+    for (int i = 0; i < 1000; ++i) {
+        d.push_back('a' + i % 26);
+    }
+
+    s.write(d.data(), 300);
+    SIREN_TEST_ASSERT(s.getTotalDataSize() == 300);
+    SIREN_TEST_ASSERT(s.getDataSize() < 64);
+    iovec v[16];
+    int n = s.getDataVector(v, 16);
+    std::string d2;
+
+    for (int i = 0; i < n; ++i) {
+        d2.append(static_cast<char *>(v[i].iov_base), v[i].iov_len);
+    }
+
+    SIREN_TEST_ASSERT(d2 == d.substr(0, 300));
+    char b[1000];
+    s.read(b, 100);
+    SIREN_TEST_ASSERT(std::memcmp(b, d.data(), 100) == 0);
+    s.write(d.data() + 300, 700);
+    s.reserveBuffer(500);
+    SIREN_TEST_ASSERT(s.getTotalBufferSize() >= 500);
+    n = s.getBufferVector(v, 16);
+    std::size_t m = 0;
+
+    for (int i = 0; i < n; ++i) {
+        m += v[i].iov_len;
+    }
+
+    SIREN_TEST_ASSERT(m == s.getTotalBufferSize());
+    std::memcpy(s.getBuffer(), "x", 1);
+    s.commitBuffer(1);
+    s.read(b, 900);
+    SIREN_TEST_ASSERT(std::memcmp(b, d.data() + 100, 900) == 0);
+    SIREN_TEST_ASSERT(s.getTotalDataSize() == 1);
+    SIREN_TEST_ASSERT(*static_cast<char *>(s.getData()) == 'x');
+    s.discardData(1);
+    SIREN_TEST_ASSERT(s.getTotalDataSize() == 0);
+    SIREN_TEST_ASSERT(s.getBufferSize() >= 1);
+    SegmentedStream s2(std::move(s));
+    s2.reset();
+    SIREN_TEST_ASSERT(s2.getTotalBufferSize() == 0);
+}
+
+}
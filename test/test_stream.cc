@@ -1,3 +1,7 @@
+#include <cstring>
+#include <string>
+
+#include "archive.h"
 #include "stream.h"
 #include "test.h"
 
@@ -12,4 +16,74 @@ SIREN_TEST("TODO")
     // TODO
 }
 
+
+SIREN_TEST("Wrap around ring streams")
+{
+    Stream s(StreamStorage::Ring);
+    s.reserveBuffer(100);
+    std::size_t n = s.getBufferSize();
+    SIREN_TEST_ASSERT(n >= 4096);
+    char *b = static_cast<char *>(s.getBuffer());
+
+    for (int i = 0; i < 10; ++i) {
+        std::string d(n / 3, 'a' + i);
+        s.write(d.data(), d.size());
+        SIREN_TEST_ASSERT(std::memcmp(s.getData(), d.data(), d.size()) == 0);
+        s.discardData(d.size());
+        // no memmove, ever
+        SIREN_TEST_ASSERT(static_cast<char *>(s.getData()) < b + n);
+    }
+
+    SIREN_TEST_ASSERT(s.getBufferSize() == n);
+    Archive a(&s);
+    std::string x(n - 100, 'x');
+    a << x << 123;
+    s.commitBuffer(a.getNumberOfPreWrittenBytes());
+    std::string y;
+    int z;
+    a >> y >> z;
+    s.discardData(a.getNumberOfPreReadBytes());
+    SIREN_TEST_ASSERT(y == x && z == 123);
+    s.write(x.data(), x.size());
+    s.reserveBuffer(n);
+    SIREN_TEST_ASSERT(s.getBufferSize() >= n);
+    SIREN_TEST_ASSERT(std::memcmp(s.getData(), x.data(), x.size()) == 0);
+    Stream s2(std::move(s));
+    SIREN_TEST_ASSERT(s2.getDataSize() == x.size());
+}
+
+
+SIREN_TEST("Shrink streams after large messages")
+{
+    Stream s;
+    std::string m(1024 * 1024, 'm');
+    s.write(m.data(), m.size());
+    s.discardData(m.size());
+    SIREN_TEST_ASSERT(s.getBufferSize() >= m.size());
+    std::string d(100, 'd');
+
+    for (int i = 0; i < 16; ++i) {
+        s.write(d.data(), d.size());
+        s.discardData(d.size());
+    }
+
+    // the period which saw the large message keeps the memory
+    SIREN_TEST_ASSERT(s.getBufferSize() >= m.size());
+
+    for (int i = 0; i < 16; ++i) {
+        s.write(d.data(), d.size());
+        s.discardData(d.size());
+    }
+
+    SIREN_TEST_ASSERT(s.getBufferSize() < m.size());
+
+    for (int i = 0; i < 100; ++i) {
+        s.write(d.data(), d.size());
+        SIREN_TEST_ASSERT(std::memcmp(s.getData(), d.data(), d.size()) == 0);
+        s.discardData(d.size());
+    }
+
+    SIREN_TEST_ASSERT(s.getBufferSize() <= 4096);
+}
+
 }
@@ -0,0 +1,94 @@
+#include <vector>
+
+#include "ip_endpoint.h"
+#include "loop.h"
+#include "tcp_connection_pool.h"
+#include "tcp_socket.h"
+#include "test.h"
+
+
+namespace {
+
+using namespace siren;
+
+
+SIREN_TEST("Reuse pooled TCP connections")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    std::vector<TCPSocket> css;
+
+    void *f = l.createFiber([&] () -> void {
+        for (;;) {
+            css.push_back(ss.accept());
+        }
+    }, 16 * 1024);
+
+    TCPConnectionPool cp(&l, 1);
+    int n = 0;
+
+    l.createFiber([&] () -> void {
+        TCPSocket s1 = cp.acquireConnection(le);
+        IPEndpoint ipe = s1.getLocalEndpoint();
+
+        // the outer fiber exits first, so its locals are captured by value
+        l.createFiber([&, ipe] () -> void {
+            TCPSocket s2 = cp.acquireConnection(le);
+            SIREN_TEST_ASSERT(n == 1);
+            SIREN_TEST_ASSERT(s2.getLocalEndpoint().portNumber == ipe.portNumber);
+            cp.releaseConnection(le, std::move(s2), false);
+            SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 0);
+            TCPSocket s3 = cp.acquireConnection(le);
+            SIREN_TEST_ASSERT(s3.getLocalEndpoint().portNumber != ipe.portNumber);
+            cp.releaseConnection(le, std::move(s3));
+            l.interruptFiber(f);
+        }, 16 * 1024);
+
+        l.usleep(10 * 1000);
+        n = 1;
+        cp.releaseConnection(le, std::move(s1));
+        SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 1);
+    }, 16 * 1024);
+
+    l.run();
+    SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 1);
+}
+
+
+SIREN_TEST("Expire and check pooled TCP connections")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    TCPConnectionPool cp(&l, 0, 1, 0, 50);
+
+    l.createFiber([&] () -> void {
+        TCPSocket s1 = cp.acquireConnection(le);
+        TCPSocket s2 = cp.acquireConnection(le);
+        TCPSocket cs1 = ss.accept();
+        TCPSocket cs2 = ss.accept();
+        cp.releaseConnection(le, std::move(s1));
+        cp.releaseConnection(le, std::move(s2));
+        SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 2);
+        l.usleep(150 * 1000);
+        SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 1);
+        cs1.closeWrite();
+        cs2.closeWrite();
+        l.usleep(10 * 1000);
+        TCPSocket s3 = cp.acquireConnection(le);
+        SIREN_TEST_ASSERT(cp.getNumberOfIdleConnections(le) == 0);
+        TCPSocket cs3 = ss.accept();
+        SIREN_TEST_ASSERT(s3.getLocalEndpoint().portNumber
+                          == cs3.getRemoteEndpoint().portNumber);
+        cp.releaseConnection(le, std::move(s3));
+    }, 16 * 1024);
+
+    l.run();
+}
+
+}
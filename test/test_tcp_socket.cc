@@ -1,7 +1,12 @@
+#include <cerrno>
 #include <cstring>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include "ip_endpoint.h"
 #include "loop.h"
+#include "segmented_stream.h"
 #include "stream.h"
 #include "tcp_socket.h"
 #include "test.h"
@@ -103,5 +108,175 @@ SIREN_TEST("TCP echo client/server")
     l.run();
 }
 
+
+SIREN_TEST("Accept TCP connections in batch")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    std::vector<TCPSocket> css;
+
+    l.createFiber([&] () -> void {
+        for (int i = 0; i < 3; ++i) {
+            css.emplace_back(&l);
+            css.back().connect(IPEndpoint(0x7F000001, le.portNumber));
+        }
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        int n = 0;
+
+        do {
+            n += ss.acceptAll([&] (TCPSocket cs, const IPEndpoint &ipe) -> void {
+                SIREN_TEST_ASSERT(cs.isValid());
+                SIREN_TEST_ASSERT(ipe.address == 0x7F000001);
+            });
+        } while (n < 3);
+
+        SIREN_TEST_ASSERT(n == 3);
+        SIREN_TEST_ASSERT(!ss.tryAccept().isValid());
+    }, 16 * 1024);
+
+    l.run();
+}
+
+
+SIREN_TEST("Listen on SO_REUSEPORT shards")
+{
+    Loop l1, l2;
+    std::vector<TCPSocket> ss = TCPSocket::ListenShards({&l1, &l2}, IPEndpoint(0x7F000001, 0));
+    SIREN_TEST_ASSERT(ss.size() == 2);
+    SIREN_TEST_ASSERT(ss[0].getLocalEndpoint().portNumber != 0);
+    SIREN_TEST_ASSERT(ss[0].getLocalEndpoint().portNumber
+                      == ss[1].getLocalEndpoint().portNumber);
+    ss[0].setReusePortCPUAffinity(2);
+}
+
+
+SIREN_TEST("Accept TCP connections through SO_REUSEPORT shards")
+{
+    Loop l1, l2, l3;
+    std::vector<TCPSocket> ss = TCPSocket::ListenShards({&l1, &l2}, IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss[0].getLocalEndpoint();
+    int ns[2] = {0, 0};
+    std::vector<std::thread> ts;
+
+    for (int i = 0; i < 2; ++i) {
+        ts.emplace_back([&, i] () -> void {
+            Loop *l = i == 0 ? &l1 : &l2;
+
+            l->createFiber([&, i] () -> void {
+                ss[i].setReceiveTimeout(500);
+
+                for (;;) {
+                    try {
+                        TCPSocket cs = ss[i].accept();
+                        ++ns[i];
+                    } catch (const std::system_error &exception) {
+                        SIREN_TEST_ASSERT(exception.code().value() == EAGAIN);
+                        break;
+                    }
+                }
+            }, 16 * 1024);
+
+            l->run();
+        });
+    }
+
+    std::vector<TCPSocket> css;
+
+    // the kernel spreads connections over the shards by hashing their addresses
+    l3.createFiber([&] () -> void {
+        for (int i = 0; i < 32; ++i) {
+            css.emplace_back(&l3);
+            css.back().connect(le);
+        }
+    }, 16 * 1024);
+
+    l3.run();
+
+    for (std::thread &t : ts) {
+        t.join();
+    }
+
+    SIREN_TEST_ASSERT(ns[0] + ns[1] == 32);
+    SIREN_TEST_ASSERT(ns[0] >= 1);
+    SIREN_TEST_ASSERT(ns[1] >= 1);
+}
+
+
+SIREN_TEST("Connect with TCP Fast Open")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.setFastOpen(16);
+    ss.setDeferAccept(1);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+
+    l.createFiber([&] () -> void {
+        for (int i = 0; i < 2; ++i) {
+            TCPSocket cs = ss.accept();
+            char request[100];
+            cs.read(request, sizeof(request));
+            SIREN_TEST_ASSERT(std::strcmp(request, "ping!") == 0);
+        }
+    }, 16 * 1024);
+
+    // the second connection only carries its data in the SYN if the server side of Fast Open is
+    // enabled by net.ipv4.tcp_fastopen, otherwise both take the cookie-less path
+    l.createFiber([&] () -> void {
+        for (int i = 0; i < 2; ++i) {
+            TCPSocket cs(&l);
+            const char request[] = "ping!";
+            SIREN_TEST_ASSERT(cs.connectAndWrite(le, request, sizeof(request))
+                              == sizeof(request));
+            cs.closeWrite();
+        }
+    }, 16 * 1024);
+
+    l.run();
 }
 
+
+SIREN_TEST("Read into streams without reserved buffers")
+{
+    Loop l;
+    TCPSocket ss(&l);
+    ss.setReuseAddress(true);
+    ss.listen(IPEndpoint(0x7F000001, 0));
+    IPEndpoint le = ss.getLocalEndpoint();
+    std::vector<char> m(300 * 1024);
+
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        m[i] = i % 251;
+    }
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs = ss.accept();
+        Stream s;
+        SIREN_TEST_ASSERT(cs.read(&s) >= 1);
+        SIREN_TEST_ASSERT(s.getDataSize() >= 1);
+        while (cs.read(&s) >= 1);
+        SIREN_TEST_ASSERT(s.getDataSize() == m.size());
+        SIREN_TEST_ASSERT(std::memcmp(s.getData(), m.data(), m.size()) == 0);
+    }, 16 * 1024);
+
+    l.createFiber([&] () -> void {
+        TCPSocket cs(&l);
+        cs.connect(le);
+
+        for (std::size_t i = 0; i < m.size();) {
+            i += cs.write(m.data() + i, m.size() - i);
+        }
+
+        cs.closeWrite();
+    }, 16 * 1024);
+
+    l.run();
+}
+
+}
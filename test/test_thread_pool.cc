@@ -1,5 +1,9 @@
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
+#include <sched.h>
 #include <unistd.h>
 
 #include "assert.h"
@@ -17,6 +21,8 @@ SIREN_TEST("Add thread pool tasks")
 {
     struct MyThreadPoolTask : ThreadPoolTask
     {
+        int *a;
+        int i;
     };
 
     int a[5];
@@ -24,10 +30,14 @@ SIREN_TEST("Add thread pool tasks")
     MyThreadPoolTask ts[5];
 
     for (int i = 0; i < 5; ++i) {
-        tp.addTask(&ts[i], [&a, i] () -> void {
-            a[i] = i;
-            throw i;
-        });
+        ts[i].a = a;
+        ts[i].i = i;
+
+        tp.addTask(&ts[i], [] (void *x) -> void {
+            auto t = static_cast<MyThreadPoolTask *>(x);
+            t->a[t->i] = t->i;
+            throw t->i;
+        }, &ts[i]);
     }
 
     int n = 5;
@@ -63,26 +73,242 @@ SIREN_TEST("Remove thread pool tasks")
 {
     struct MyThreadPoolTask : ThreadPoolTask
     {
+        bool done = false;
     };
 
     ThreadPool tp(1);
     MyThreadPoolTask t;
-    bool done = false;
 
-    tp.addTask(&t, [&] () -> void {
+    tp.addTask(&t, [] (void *x) -> void {
         usleep(100 * 1000);
-        done = true;
+        static_cast<MyThreadPoolTask *>(x)->done = true;
+    }, &t);
+
+    if (tp.removeTask(&t)) {
+        SIREN_TEST_ASSERT(!t.done);
+    } else {
+        std::uint64_t dummy;
+        int r = read(tp.getEventFD(), &dummy, sizeof(dummy));
+        SIREN_UNUSED(r);
+        SIREN_ASSERT(r == sizeof(dummy));
+        int n = 0;
+
+        tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+            SIREN_TEST_ASSERT(x == &t);
+            x->check();
+            ++n;
+        });
+
+        SIREN_TEST_ASSERT(n == 1);
+        SIREN_TEST_ASSERT(t.done);
+    }
+}
+
+
+SIREN_TEST("Cancel running thread pool tasks")
+{
+    struct MyThreadPoolTask : ThreadPoolTask
+    {
+        std::atomic<bool> f{false};
+        bool cancelled = false;
+    };
+
+    ThreadPool tp(1);
+    MyThreadPoolTask t;
+
+    tp.addTask(&t, [] (void *x) -> void {
+        auto t = static_cast<MyThreadPoolTask *>(x);
+        t->f = true;
+
+        while (!ThreadPool::CurrentTaskIsCancelled()) {
+            usleep(1000);
+        }
+
+        t->cancelled = true;
+    }, &t);
+
+    while (!t.f.load()) {
+        usleep(1000);
+    }
+
+    SIREN_TEST_ASSERT(!tp.removeTask(&t));
+    std::uint64_t dummy;
+    int r = read(tp.getEventFD(), &dummy, sizeof(dummy));
+    SIREN_UNUSED(r);
+    SIREN_ASSERT(r == sizeof(dummy));
+
+    tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+        x->check();
     });
 
-    bool taskIsCompleted;
-    tp.removeTask(&t, &taskIsCompleted);
+    SIREN_TEST_ASSERT(t.cancelled);
+}
+
 
-    if (taskIsCompleted) {
-        SIREN_TEST_ASSERT(done);
-        t.check();
-    } else {
-        SIREN_TEST_ASSERT(!done);
+SIREN_TEST("Add and remove many thread pool tasks")
+{
+    struct MyThreadPoolTask : ThreadPoolTask
+    {
+    };
+
+    ThreadPool tp(4);
+    std::vector<MyThreadPoolTask> ts(5000);
+    std::atomic<int> n(0);
+
+    for (MyThreadPoolTask &t : ts) {
+        tp.addTask(&t, [] (void *x) -> void {
+            ++*static_cast<std::atomic<int> *>(x);
+        }, &n);
+    }
+
+    int m = 0;
+
+    for (std::size_t i = 0; i < ts.size(); i += 2) {
+        if (!tp.removeTask(&ts[i])) {
+            ++m;
+        }
+    }
+
+    int k = m + ts.size() / 2;
+
+    while (k >= 1) {
+        std::uint64_t dummy;
+        int r = read(tp.getEventFD(), &dummy, sizeof(dummy));
+        SIREN_UNUSED(r);
+        SIREN_ASSERT(r == sizeof(dummy));
+
+        tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+            x->check();
+            --k;
+        });
+    }
+
+    SIREN_TEST_ASSERT(n.load() == m + static_cast<int>(ts.size() / 2));
+}
+
+
+SIREN_TEST("Coalesce thread pool completion events")
+{
+    struct MyThreadPoolTask : ThreadPoolTask
+    {
+    };
+
+    ThreadPool tp(1);
+    MyThreadPoolTask ts[10];
+    std::atomic<int> n(0);
+
+    for (MyThreadPoolTask &t : ts) {
+        tp.addTask(&t, [] (void *x) -> void {
+            ++*static_cast<std::atomic<int> *>(x);
+        }, &n);
+    }
+
+    while (n.load() < 10) {
+        usleep(1000);
+    }
+
+    std::uint64_t k;
+    int r = read(tp.getEventFD(), &k, sizeof(k));
+    SIREN_UNUSED(r);
+    SIREN_ASSERT(r == sizeof(k));
+    SIREN_TEST_ASSERT(k == 1);
+    int m = 0;
+
+    do {
+        tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+            x->check();
+            ++m;
+        });
+    } while (m < 10);
+}
+
+
+SIREN_TEST("Resize thread pools elastically")
+{
+    struct MyThreadPoolTask : ThreadPoolTask
+    {
+    };
+
+    ThreadPool tp(1, 4, 100, 10);
+    MyThreadPoolTask ts[4];
+    SIREN_TEST_ASSERT(tp.getNumberOfThreads() == 1);
+
+    for (MyThreadPoolTask &t : ts) {
+        tp.addTask(&t, [] (void *) -> void {
+            usleep(200 * 1000);
+        }, nullptr);
+
+        usleep(30 * 1000);
     }
+
+    std::size_t n = tp.getNumberOfThreads();
+    SIREN_TEST_ASSERT(n >= 2 && n <= 4);
+    int k = 4;
+
+    do {
+        std::uint64_t dummy;
+        int r = read(tp.getEventFD(), &dummy, sizeof(dummy));
+        SIREN_UNUSED(r);
+        SIREN_ASSERT(r == sizeof(dummy));
+
+        tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+            x->check();
+            --k;
+        });
+    } while (k >= 1);
+
+    SIREN_TEST_ASSERT(tp.getNumberOfExecutedTasks() == 4);
+    SIREN_TEST_ASSERT(tp.getTotalBusyTime() >= std::chrono::milliseconds(4 * 200));
+    usleep(500 * 1000);
+    SIREN_TEST_ASSERT(tp.getNumberOfThreads() == 1);
+    SIREN_TEST_ASSERT(tp.getNumberOfWaitingTasks() == 0);
+}
+
+
+SIREN_TEST("Pin thread pool workers to CPUs")
+{
+    struct MyThreadPoolTask : ThreadPoolTask
+    {
+        int cpu = -1;
+    };
+
+    cpu_set_t cpuSet;
+    SIREN_TEST_ASSERT(sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0);
+    int cpu = 0;
+
+    while (!CPU_ISSET(cpu, &cpuSet)) {
+        ++cpu;
+    }
+
+    ThreadPool tp(2);
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    tp.setCPUAffinity(cpuSet);
+    CPU_ZERO(&cpuSet);
+    tp.getCPUAffinity(&cpuSet);
+    SIREN_TEST_ASSERT(CPU_COUNT(&cpuSet) == 1 && CPU_ISSET(cpu, &cpuSet));
+    MyThreadPoolTask ts[4];
+
+    for (MyThreadPoolTask &t : ts) {
+        tp.addTask(&t, [] (void *x) -> void {
+            static_cast<MyThreadPoolTask *>(x)->cpu = sched_getcpu();
+        }, &t);
+    }
+
+    int k = 4;
+
+    do {
+        std::uint64_t dummy;
+        int r = read(tp.getEventFD(), &dummy, sizeof(dummy));
+        SIREN_UNUSED(r);
+        SIREN_ASSERT(r == sizeof(dummy));
+
+        tp.removeCompletedTasks([&] (ThreadPoolTask *x) -> void {
+            x->check();
+            SIREN_TEST_ASSERT(static_cast<MyThreadPoolTask *>(x)->cpu == cpu);
+            --k;
+        });
+    } while (k >= 1);
 }
 
 }